@@ -0,0 +1,171 @@
+#ifndef __CDK12_ARENA_H__
+#define __CDK12_ARENA_H__
+
+#include <cstddef>
+#include <new>
+#include <utility>
+#include <vector>
+
+namespace cdk {
+
+  /**
+   * Region allocator for everything a single compilation creates (nodes,
+   * types, token strings). While an arena is installed in the current
+   * thread (see arena::scope), those objects are bump-allocated from it;
+   * when the scope ends, the objects still alive are destroyed and the
+   * memory is given back in one go. This is what keeps a resident compiler
+   * (--server) from growing with every request: the AST is never freed
+   * node by node (sequences share their children).
+   *
+   * With no arena installed, allocation falls back to the global heap and
+   * everything behaves as before.
+   */
+  class arena {
+    struct finalizer {
+      void *object;
+      void (*destroy)(void*);
+    };
+
+    struct chunk {
+      char *base;
+      size_t size;
+    };
+
+    static const size_t CHUNK = 64 * 1024;
+    std::vector<chunk> _chunks;
+    char *_next = nullptr, *_end = nullptr;
+    std::vector<finalizer> _finalizers;
+    bool _finalizing = false;
+
+  public:
+    arena() {
+    }
+    ~arena() {
+      reset();
+      for (auto &c : _chunks)
+        delete[] c.base;
+    }
+    arena(const arena&) = delete;
+    arena &operator=(const arena&) = delete;
+
+  public:
+    /** @return the arena installed in this thread (nullptr if none) */
+    static arena *&current() {
+      static thread_local arena *installed = nullptr;
+      return installed;
+    }
+
+    /** Installs an arena for the lifetime of the scope and resets it at the end. */
+    class scope {
+      arena &_arena;
+      arena *_previous;
+    public:
+      scope(arena &a) :
+          _arena(a), _previous(current()) {
+        current() = &a;
+      }
+      ~scope() {
+        _arena.reset();
+        current() = _previous;
+      }
+    };
+
+  public:
+    void *allocate(size_t size) {
+      size = (size + alignof(std::max_align_t) - 1) & ~(alignof(std::max_align_t) - 1);
+      if (_next == nullptr || (size_t)(_end - _next) < size) {
+        size_t n = size > CHUNK ? size : CHUNK;
+        _chunks.push_back(chunk { new char[n], n });
+        _next = _chunks.back().base;
+        _end = _next + n;
+      }
+      void *p = _next;
+      _next += size;
+      return p;
+    }
+
+    bool owns(const void *p) const {
+      // most queries are about recent allocations: look at the newest chunks first
+      for (size_t ix = _chunks.size(); ix-- > 0;)
+        if ((const char*)p >= _chunks[ix].base && (const char*)p < _chunks[ix].base + _chunks[ix].size)
+          return true;
+      return false;
+    }
+
+    /** Registers an object to be destroyed (but not freed) when the arena is reset. */
+    void finalize(void *object, void (*destroy)(void*)) {
+      _finalizers.push_back(finalizer { object, destroy });
+    }
+
+    /** Cancels finalization of an object that was destroyed early (e.g. with delete). */
+    void forget(void *object) {
+      if (_finalizing) return;
+      for (size_t ix = _finalizers.size(); ix-- > 0;)
+        if (_finalizers[ix].object == object) {
+          _finalizers[ix].object = nullptr;
+          return;
+        }
+    }
+
+    /** Destroys the remaining objects and keeps only the first chunk for reuse. */
+    void reset() {
+      _finalizing = true;
+      for (size_t ix = _finalizers.size(); ix-- > 0;)
+        if (_finalizers[ix].object != nullptr)
+          _finalizers[ix].destroy(_finalizers[ix].object);
+      _finalizers.clear();
+      _finalizing = false;
+
+      while (_chunks.size() > 1 || (!_chunks.empty() && _chunks.back().size != CHUNK)) {
+        delete[] _chunks.back().base;
+        _chunks.pop_back();
+      }
+      if (_chunks.empty())
+        _next = _end = nullptr;
+      else {
+        _next = _chunks.front().base;
+        _end = _next + CHUNK;
+      }
+    }
+
+  public:
+    /** Class-level operator new for arena-aware types. */
+    static void *operator_new(size_t size) {
+      if (current() != nullptr)
+        return current()->allocate(size);
+      return ::operator new(size);
+    }
+
+    /** Class-level operator delete for arena-aware types: arena memory is not freed here. */
+    static void operator_delete(void *p) {
+      if (current() != nullptr && current()->owns(p))
+        return;
+      ::operator delete(p);
+    }
+
+    /**
+     * Creates an object that belongs to the current arena (if any) and is
+     * destroyed when the arena is reset. Without an arena, this is plain new.
+     */
+    template<typename T, typename ...Args>
+    static T *make(Args &&...args) {
+      if (current() == nullptr)
+        return new T(std::forward<Args>(args)...);
+      T *object = new (current()->allocate(sizeof(T))) T(std::forward<Args>(args)...);
+      current()->finalize(object, [](void *p) { static_cast<T*>(p)->~T(); });
+      return object;
+    }
+
+    /** Counterpart of make(): deletes the object unless the arena owns it. */
+    template<typename T>
+    static void dispose(T *object) {
+      if (current() != nullptr && current()->owns(object))
+        return;
+      delete object;
+    }
+
+  };
+
+} // cdk
+
+#endif
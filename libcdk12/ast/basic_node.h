@@ -3,6 +3,7 @@
 
 #include <typeinfo>
 #include <iostream>
+#include <cdk/arena.h>
 #include "basic_ast_visitor.h"
 
 namespace cdk {
@@ -28,10 +29,24 @@ namespace cdk {
      */
     inline basic_node(int lineno) :
         _lineno(lineno) {
+      arena *a = arena::current();
+      if (a != nullptr && a->owns(this))
+        a->finalize(this, [](void *p) { static_cast<basic_node*>(p)->~basic_node(); });
     }
 
   public:
     virtual ~basic_node() {
+      if (arena::current() != nullptr)
+        arena::current()->forget(this);
+    }
+
+  public:
+    // nodes live in the current compilation's arena, if there is one
+    static void *operator new(size_t size) {
+      return arena::operator_new(size);
+    }
+    static void operator delete(void *p) {
+      arena::operator_delete(p);
     }
 
   public:
@@ -51,11 +51,13 @@ namespace cdk {
     /**
      * This is the destructor for sequence nodes. Note that this
      * destructor also causes the destruction of the node's
-     * children.
+     * children (unless they belong to an arena, which destroys
+     * them itself: sequences may share children).
      */
     inline ~sequence_node() {
       for (auto node : _nodes)
-        delete node;
+        if (arena::current() == nullptr || !arena::current()->owns(node))
+          delete node;
       _nodes.clear();
     }
 
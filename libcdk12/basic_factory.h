@@ -28,20 +28,25 @@ namespace cdk {
     const std::string _language = "";
 
   private:
-    static basic_factory *&factoriesByLanguage(const std::string &language) {
+    /**
+     * Factories register themselves during static initialization only:
+     * after that, the map is read-only and safe to share among threads.
+     */
+    static std::map<std::string, basic_factory*> &factoriesByLanguage() {
       static std::map<std::string, basic_factory*> factories;
-      return factories[language];
+      return factories;
     }
 
   public:
     static basic_factory *get_implementation(const std::string &language) {
-      return factoriesByLanguage(language);
+      auto it = factoriesByLanguage().find(language);
+      return it == factoriesByLanguage().end() ? nullptr : it->second;
     }
 
   protected:
     basic_factory(const std::string &language) :
         _language(language) {
-      factoriesByLanguage(language) = this;
+      factoriesByLanguage()[language] = this;
     }
 
   public:
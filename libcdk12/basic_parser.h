@@ -15,8 +15,8 @@ namespace cdk {
     //! @var the language to be scanned
     const std::string _language = "";
 
-    //! @var the compiler this parser belongs to
-    std::shared_ptr<compiler> _compiler = nullptr;
+    //! @var the compiler this parser belongs to (not owned: the compiler owns the parser)
+    std::weak_ptr<compiler> _compiler;
 
     //! @var the scanner providing the input tokens
     std::shared_ptr<basic_scanner> _scanner = nullptr;
@@ -24,17 +24,17 @@ namespace cdk {
   protected:
     inline basic_parser(const std::string &language,
                         std::shared_ptr<basic_scanner> scanner) :
-        _language(language), _compiler(nullptr), _scanner(scanner) {
+        _language(language), _compiler(), _scanner(scanner) {
     }
 
   public:
     virtual ~basic_parser() {
-      _compiler = nullptr;
+      _compiler.reset();
     }
 
   public:
     inline std::shared_ptr<compiler> owner() {
-      return _compiler;
+      return _compiler.lock();
     }
 
   private:
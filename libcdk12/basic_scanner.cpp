@@ -1 +1,10 @@
 #include <cdk/basic_scanner.h>
+#include <cdk/compiler.h>
+
+void cdk::basic_scanner::error(const std::string &message) const {
+  std::shared_ptr<compiler> owner = _compiler.lock();
+  if (owner)
+    owner->error(lineno(), message);
+  else
+    *_estream << lineno() << ": " << message << std::endl;
+}
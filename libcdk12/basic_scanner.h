@@ -20,8 +20,8 @@ namespace cdk {
     //! @var the language to be scanned
     const std::string _language = "";
 
-    //! @var the compiler this scanner belongs to
-    std::shared_ptr<compiler> _compiler = nullptr;
+    //! @var the compiler this scanner belongs to (not owned: the compiler owns the scanner)
+    std::weak_ptr<compiler> _compiler;
 
   protected:
     //! @var _istream is the input stream
@@ -38,7 +38,7 @@ namespace cdk {
 
   protected:
     inline basic_scanner(const std::string &language) :
-        _language(language), _compiler(nullptr), _istream(
+        _language(language), _compiler(), _istream(
             std::shared_ptr<std::istream>(&std::cin, null_deleter())), _ostream(
             std::shared_ptr<std::ostream>(&std::cout, null_deleter())), _estream(
             std::shared_ptr<std::ostream>(&std::cerr, null_deleter())) {
@@ -47,7 +47,7 @@ namespace cdk {
   public:
     //! How to destroy a scanner.
     virtual ~basic_scanner() {
-      _compiler = nullptr;
+      _compiler.reset();
       _istream = nullptr;
       _ostream = nullptr;
       _estream = nullptr;
@@ -79,7 +79,7 @@ namespace cdk {
     }
 
     inline std::shared_ptr<compiler> owner() {
-      return _compiler;
+      return _compiler.lock();
     }
 
   private:
@@ -88,6 +88,16 @@ namespace cdk {
       _compiler = compiler;
     }
 
+  public:
+    /**
+     * @return the scanner running in this thread (see yy_scanner::scan), so
+     * that a generated lexer can report its errors to its compiler
+     */
+    static basic_scanner *&current() {
+      static thread_local basic_scanner *running = nullptr;
+      return running;
+    }
+
   public:
     virtual void switch_streams() = 0;
 
@@ -105,16 +115,15 @@ namespace cdk {
 
     /**
      * Output error message.
+     * The message is recorded in the owner compiler's diagnostics (if any).
      */
-    virtual void error(const std::string &message) const {
-      *_estream << lineno() << ": " << message << std::endl;
-    }
+    virtual void error(const std::string &message) const;
 
     /**
      * Output error message.
      */
     virtual void error(const char * const message) const {
-      *_estream << lineno() << ": " << message << std::endl;
+      error(std::string(message));
     }
 
   };
@@ -16,26 +16,30 @@ namespace cdk {
     /**
      * This is the registry for all evaluators, indexed by target.
      * Subclasses register their instances here through calls to the
-     * superclass constructor.
+     * superclass constructor. Registration only happens during static
+     * initialization: afterwards, the registry is never modified and
+     * may be consulted concurrently by any number of compilers.
      */
-    static basic_target *&targets_by_name(const std::string &target) {
+    static std::map<std::string, basic_target*> &targets_by_name() {
       static std::map<std::string, basic_target*> _targets_by_name;
-      return _targets_by_name[target];
+      return _targets_by_name;
     }
 
   public:
     /**
      * How to get an evaluator for a given target.
+     * Lookups never insert into the registry.
      * @param target the target name: "asm", "c", "xml", etc.
-     * @return a pointer to the evaluator object
+     * @return a pointer to the evaluator object (nullptr if none exists)
      */
     static basic_target *get_target_for(const std::string &target) {
-      return targets_by_name(target);
+      auto it = targets_by_name().find(target);
+      return it == targets_by_name().end() ? nullptr : it->second;
     }
 
   protected:
     basic_target(const char *target) {
-      targets_by_name(target) = this;
+      targets_by_name()[target] = this;
     }
 
   public:
@@ -47,6 +51,8 @@ namespace cdk {
     /**
      * Evaluation algorithm for a syntax tree: processes the
      * tree and sends the result to the output stream.
+     * Targets are shared by all compilers: implementations must keep
+     * every piece of per-compilation state local to this call.
      * @param compiler object representing the compiler as a whole
      * @return true if the operation is successful
      */
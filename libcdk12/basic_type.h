@@ -2,6 +2,7 @@
 #define __CDK12_SEMANTICS_EXPRESSIONTYPE_H__
 
 #include <cstdlib>
+#include <cdk/arena.h>
 
 /**
  * This is a quick and very dirty approach to type information.
@@ -35,6 +36,14 @@ struct basic_type {
     return _subtype;
   }
 
+  // types live in the current compilation's arena, if there is one
+  static void *operator new(size_t size) {
+    return cdk::arena::operator_new(size);
+  }
+  static void operator delete(void *p) {
+    cdk::arena::operator_delete(p);
+  }
+
 public:
 
   static const type TYPE_UNSPEC  = 0;
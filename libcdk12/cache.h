@@ -0,0 +1,217 @@
+#ifndef __CDK12_CACHE_H__
+#define __CDK12_CACHE_H__
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdint>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utime.h>
+
+namespace cdk {
+
+  /**
+   * On-disk compilation cache. Entries are named after a hash of everything
+   * that determines the output: the source text, the language, the target,
+   * the -O/-g flags and the compiler executable itself (so that rebuilding
+   * the compiler invalidates old entries). On a hit, the cached file is
+   * hard-linked (or copied) to the output file and nothing else is done.
+   * Outputs are copied into the cache, never linked, so that entries do not
+   * change if someone edits an output file in place.
+   *
+   * The directory is kept under a size limit: after each store (or, if
+   * fragments were saved without one, when the cache is destroyed), the
+   * least recently used entries are removed.
+   */
+  class cache {
+    std::string _directory;
+    size_t _limit;
+    int _hits = 0, _misses = 0;
+    int _reused = 0, _regenerated = 0; // fragments
+    bool _untrimmed = false;           // saved since the last trim
+
+  public:
+    /**
+     * @param directory where entries live (created if needed); empty disables the cache
+     * @param limit maximum total size of the entries, in bytes
+     */
+    cache(const std::string &directory, size_t limit) :
+        _directory(directory), _limit(limit) {
+      if (_directory != "")
+        ::mkdir(_directory.c_str(), 0777);
+    }
+
+    ~cache() {
+      if (_untrimmed) trim();
+    }
+
+    bool enabled() const {
+      return _directory != "";
+    }
+    int hits() const {
+      return _hits;
+    }
+    int misses() const {
+      return _misses;
+    }
+    int reused() const {
+      return _reused;
+    }
+    int regenerated() const {
+      return _regenerated;
+    }
+
+  private:
+    static void fnv1a(uint64_t &h, const void *data, size_t size) {
+      for (size_t ix = 0; ix < size; ix++) {
+        h ^= ((const unsigned char*)data)[ix];
+        h *= 1099511628211ULL;
+      }
+    }
+    static void fnv1a(uint64_t &h, const std::string &s) {
+      fnv1a(h, s.data(), s.size() + 1); // include the terminator as separator
+    }
+
+    static bool copy(const std::string &from, const std::string &to) {
+      std::ifstream in(from, std::ios::binary);
+      std::ofstream out(to, std::ios::binary | std::ios::trunc);
+      return in && out && (out << in.rdbuf());
+    }
+
+    std::string path(const std::string &key) const {
+      return _directory + "/" + key;
+    }
+
+  public:
+    /** @return the name of the entry for the given compilation */
+    std::string key(const std::string &language, const std::string &source, const std::string &target,
+                    bool optimize, bool debug, const std::string &flags = "") const {
+      uint64_t h = 14695981039346656037ULL;
+      struct stat self;
+      if (::stat("/proc/self/exe", &self) == 0) {
+        fnv1a(h, &self.st_mtime, sizeof(self.st_mtime));
+        fnv1a(h, &self.st_size, sizeof(self.st_size));
+      }
+      fnv1a(h, language);
+      fnv1a(h, target);
+      fnv1a(h, optimize ? "O" : "");
+      fnv1a(h, debug ? "g" : "");
+      fnv1a(h, flags);
+      fnv1a(h, source);
+
+      char name[17];
+      snprintf(name, sizeof(name), "%016llx", (unsigned long long)h);
+      return std::string(name) + "." + target;
+    }
+
+    /**
+     * Looks an entry up and, if present, places it in the output file.
+     * @return true on a hit
+     */
+    bool fetch(const std::string &key, const std::string &ofile) {
+      std::string entry = path(key);
+      if (::access(entry.c_str(), R_OK) != 0) {
+        _misses++;
+        return false;
+      }
+      // only regular files are replaced by links (the output may be, e.g., /dev/stdout)
+      struct stat st;
+      bool regular = ::lstat(ofile.c_str(), &st) != 0 || S_ISREG(st.st_mode);
+      if (regular) ::unlink(ofile.c_str());
+      if (!(regular && ::link(entry.c_str(), ofile.c_str()) == 0) && !copy(entry, ofile)) {
+        _misses++;
+        return false;
+      }
+      ::utime(entry.c_str(), nullptr); // mark as recently used
+      _hits++;
+      return true;
+    }
+
+    /** Adds the output file to the cache and trims the directory to its size limit. */
+    void store(const std::string &key, const std::string &ofile) {
+      std::string entry = path(key), temporary = entry + "." + std::to_string(::getpid()) + ".tmp";
+      ::unlink(temporary.c_str());
+      if (!copy(ofile, temporary))
+        return;
+      if (::rename(temporary.c_str(), entry.c_str()) != 0) {
+        ::unlink(temporary.c_str());
+        return;
+      }
+      trim();
+    }
+
+    /**
+     * Fragments are pieces of output (e.g. the code of one function) that a
+     * target keeps for later compilations. They share the directory (and the
+     * size limit) with whole outputs.
+     * @return true if the fragment was found
+     */
+    bool load(const std::string &key, std::string &contents) {
+      std::ifstream in(path(key), std::ios::binary);
+      if (!in) {
+        _regenerated++;
+        return false;
+      }
+      std::ostringstream oss;
+      oss << in.rdbuf();
+      contents = oss.str();
+      ::utime(path(key).c_str(), nullptr);
+      _reused++;
+      return true;
+    }
+
+    void save(const std::string &key, const std::string &contents) {
+      std::string entry = path(key), temporary = entry + "." + std::to_string(::getpid()) + ".tmp";
+      {
+        std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+        if (!(out << contents)) return;
+      }
+      if (::rename(temporary.c_str(), entry.c_str()) != 0)
+        ::unlink(temporary.c_str());
+      else
+        _untrimmed = true;   // trimmed once per compilation, not per fragment
+    }
+
+  private:
+    void trim() {
+      _untrimmed = false;
+      struct entry {
+        std::string name;
+        time_t used;
+        size_t size;
+      };
+      std::vector<entry> entries;
+      size_t total = 0;
+
+      DIR *dir = ::opendir(_directory.c_str());
+      if (dir == nullptr) return;
+      while (dirent *d = ::readdir(dir)) {
+        struct stat st;
+        std::string name = path(d->d_name);
+        if (d->d_name[0] == '.' || ::stat(name.c_str(), &st) != 0 || !S_ISREG(st.st_mode)) continue;
+        entries.push_back(entry { name, st.st_mtime, (size_t)st.st_size });
+        total += st.st_size;
+      }
+      ::closedir(dir);
+
+      if (total <= _limit) return;
+      std::sort(entries.begin(), entries.end(), [](const entry &a, const entry &b) {
+        return a.used < b.used;
+      });
+      for (auto &e : entries) {
+        if (total <= _limit) break;
+        if (::unlink(e.name.c_str()) == 0)
+          total -= e.size;
+      }
+    }
+
+  };
+
+} // cdk
+
+#endif
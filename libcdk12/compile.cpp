@@ -0,0 +1 @@
+#include <cdk/compile.h>
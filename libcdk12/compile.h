@@ -0,0 +1,75 @@
+#ifndef __CDK12_COMPILE_H__
+#define __CDK12_COMPILE_H__
+
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cdk/compiler.h>
+#include <cdk/basic_factory.h>
+
+namespace cdk {
+
+  /**
+   * Outcome of an in-memory compilation: on success, <tt>output</tt> holds
+   * whatever the target produced; on failure, <tt>diagnostics</tt> says why.
+   */
+  struct compilation_result {
+    bool ok = false;
+    std::string output;
+    std::vector<diagnostic> diagnostics;
+  };
+
+  /**
+   * Library entry point: compile a source buffer and return the output buffer.
+   * Input and output go through the scanner's input/output streams (string
+   * streams here), so no files are read or created. Messages are collected
+   * in the result instead of being written to the standard error stream.
+   *
+   * @param language name of the source language (e.g. "xpl")
+   * @param source the program text
+   * @param target the output format ("asm", "xml", ...)
+   * @param optimize whether to optimize (-O)
+   * @param debug whether to produce debug output (-g)
+   * @param flags code generation flags (-f options, without the "-f")
+   * @return the compilation result
+   */
+  inline compilation_result compile(const std::string &language, const std::string &source,
+                                    const std::string &target = "asm", bool optimize = false,
+                                    bool debug = false,
+                                    const std::vector<std::string> &flags = {}) {
+    compilation_result result;
+
+    basic_factory *factory = basic_factory::get_implementation(language);
+    if (factory == nullptr) {
+      result.diagnostics.push_back(
+          diagnostic { 0, "FATAL: No implementation available for language '" + language + "'." });
+      return result;
+    }
+
+    std::shared_ptr<compiler> compiler = factory->create_compiler();
+    std::shared_ptr<std::istringstream> input = std::make_shared<std::istringstream>(source);
+    std::shared_ptr<std::ostringstream> output = std::make_shared<std::ostringstream>();
+    std::shared_ptr<std::ostringstream> errors = std::make_shared<std::ostringstream>();
+
+    compiler->extension(target);
+    compiler->optimize(optimize);
+    compiler->debug(debug);
+    for (auto &f : flags)
+      compiler->set_flag(f);
+    compiler->scanner()->input_stream(input);
+    compiler->scanner()->output_stream(output);
+    compiler->scanner()->error_stream(errors);
+
+    if (compiler->parse() == 0 && compiler->errors() == 0 && compiler->evaluate()) {
+      output->flush();
+      result.ok = true;
+      result.output = output->str();
+    }
+    result.diagnostics = compiler->diagnostics();
+    return result;
+  }
+
+} // cdk
+
+#endif
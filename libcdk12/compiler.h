@@ -4,9 +4,12 @@
 #include <cstdlib>
 #include <iostream>
 #include <fstream>
+#include <map>
 #include <memory>
 #include <string>
 #include <vector>
+#include <sys/stat.h>
+#include <unistd.h>
 #include <cdk/null_deleter.h>
 #include <cdk/basic_scanner.h>
 #include <cdk/basic_parser.h>
@@ -15,7 +18,22 @@
 namespace cdk {
 
   class basic_node;
+  class cache;
+
+  /**
+   * A message produced while compiling: the source line it refers to
+   * (0 if none) and its text. Each compiler keeps its own list.
+   */
+  struct diagnostic {
+    int line;
+    std::string message;
+  };
 
+  /**
+   * A compiler instance holds all the state of a single compilation
+   * (scanner, parser, AST, flags and diagnostics): different instances
+   * share nothing and may be used concurrently from different threads.
+   */
   class compiler: public std::enable_shared_from_this<compiler> {
     /** @var _name is the compiler's name */
     std::string _name;
@@ -51,9 +69,21 @@ namespace cdk {
     /** @var _debug is a flag: debug (default behaviour: false) */
     bool _debug = true;
 
+    /** @var _flags are the -f<name>[=<value>] options (code generation switches) */
+    std::map<std::string, std::string> _flags;
+
     /** Compilation errors */
     int _errors = 0;
 
+    /** @var _cache is where targets may keep reusable pieces of output (not owned; may be null) */
+    cdk::cache *_cache = nullptr;
+
+    /** Messages reported during this compilation (in order) */
+    std::vector<diagnostic> _diagnostics;
+
+    /** Notes from the targets about what they did (e.g. code removed), shown by --report */
+    std::vector<std::string> _remarks;
+
   public:
     static inline std::shared_ptr<compiler> create(const std::string &language,
                                                    std::shared_ptr<basic_scanner> scanner,
@@ -114,6 +144,10 @@ namespace cdk {
     }
     inline void ofile(const std::string &ofile) {
       _ofile = ofile;
+      struct stat st;
+      // replace, rather than overwrite, files shared with others (e.g. cache entries)
+      if (_ofile != "" && ::lstat(_ofile.c_str(), &st) == 0 && S_ISREG(st.st_mode) && st.st_nlink > 1)
+        ::unlink(_ofile.c_str());
       if (_ofile != "")
         _scanner->output_stream(std::make_shared<std::ofstream>(_ofile.c_str()));
       else
@@ -128,6 +162,10 @@ namespace cdk {
       return _scanner->output_stream();
     }
 
+    inline std::shared_ptr<std::ostream> estream() {
+      return _scanner->error_stream();
+    }
+
   public:
     inline basic_node *ast() {
       return _ast;
@@ -165,18 +203,73 @@ namespace cdk {
       _debug = debug;
     }
 
+    /** @return whether -f<name> (or -f<name>=<value>) was given */
+    inline bool flag(const std::string &name) const {
+      return _flags.count(name) > 0;
+    }
+    /** @return the value of -f<name>=<value> (or the default, if absent) */
+    inline const std::string &flag(const std::string &name, const std::string &absent) const {
+      auto it = _flags.find(name);
+      return it == _flags.end() ? absent : it->second;
+    }
+    /** Sets a flag from its command line text (e.g. "ir" or "inline-threshold=40"). */
+    inline void set_flag(const std::string &option) {
+      size_t eq = option.find('=');
+      if (eq == std::string::npos)
+        _flags[option] = "";
+      else
+        _flags[option.substr(0, eq)] = option.substr(eq + 1);
+    }
+    /** @return all flags, in a canonical form (e.g. for cache keys) */
+    inline std::string flags() const {
+      std::string text;
+      for (auto &f : _flags)
+        text += " -f" + f.first + (f.second == "" ? "" : "=" + f.second);
+      return text;
+    }
+
+    inline cdk::cache *cache() const {
+      return _cache;
+    }
+    inline void cache(cdk::cache *cache) {
+      _cache = cache;
+    }
+
     inline int errors() const {
       return _errors;
     }
 
+    inline const std::vector<diagnostic> &diagnostics() const {
+      return _diagnostics;
+    }
+
+    /**
+     * Report an error: it is counted, recorded in this compiler's
+     * diagnostics and written to its error stream.
+     * @param line source line (0 if not applicable)
+     * @param message the error message
+     */
+    inline void error(int line, const std::string &message) {
+      _errors++;
+      _diagnostics.push_back(diagnostic { line, message });
+      *estream() << line << ": " << message << std::endl;
+    }
+
+    inline const std::vector<std::string> &remarks() const {
+      return _remarks;
+    }
+    inline void remark(const std::string &text) {
+      _remarks.push_back(text);
+    }
+
   public:
 
     inline int parse() {
       if (_parser)
         return _parser->parse();
       else {
-        std::cerr << "FATAL: No parser available. Exiting..." << std::endl;
-        exit(1);
+        error(0, "FATAL: No parser available.");
+        return 1;
       }
     }
 
@@ -190,9 +283,8 @@ namespace cdk {
       if (evaluator)
         return evaluator->evaluate(shared_from_this());
       else {
-        std::cerr << "FATAL: No evaluator defined for target '" << _extension << "'. Exiting..."
-            << std::endl;
-        exit(1);
+        error(0, "FATAL: No evaluator defined for target '" + _extension + "'.");
+        return false;
       }
     }
 
@@ -269,6 +269,10 @@ namespace cdk {
      * Arithmetic instruction: integer multiplication of two integer values.
      */
     virtual void MUL() = 0;
+    /**
+     * Arithmetic instruction: high 32 bits of the (signed, 64 bit) product of two integer values.
+     */
+    virtual void MULHI() = 0;
     /**
      * Arithmetic instruction: negation (symmetric) of integer value.
      */
@@ -423,6 +427,30 @@ namespace cdk {
      * Function definition instructions: pushes the value in the accumulator register to the stack.
      */
     virtual void PUSH() = 0;
+    /**
+     * Function definition instructions: removes a value from the stack to the n-th
+     * argument register (0 is the accumulator). Used by internal calls, that pass
+     * their first arguments in registers.
+     */
+    virtual void POPR(int n) = 0;
+    /**
+     * Function definition instructions: pushes the value in the n-th argument
+     * register (see <tt>POPR</tt>) to the stack.
+     */
+    virtual void PUSHR(int n) = 0;
+    /**
+     * Function definition instructions: operating system call. Removes the call
+     * number and then its arguments (pushed last to first) from the stack and
+     * pushes the result.
+     *
+     * @param args is the number of arguments (up to three).
+     */
+    virtual void SYSCALL(int args) = 0;
+    /**
+     * Function definition instructions: pushes the processor's cycle counter
+     * (as a double precision floating point value).
+     */
+    virtual void RDTSC() = 0;
     /**
      * Function definition instructions: removes a double precision floating point value from the stack (to a double prevision floating point register).
      */
@@ -644,6 +672,22 @@ namespace cdk {
      */
     virtual void GLOBAL(std::string label, std::string type) = 0;
 
+    /**
+     * Declare the type (see <tt>GLOBAL</tt>) of a name that is not visible to other modules.
+     *
+     * @param label is the name to be defined.
+     * @param type is the named object's type.
+     */
+    virtual void STATIC(std::string label, std::string type) = 0;
+
+    /**
+     * Debugging information: the code that follows comes from a line of the source.
+     *
+     * @param line is the line number.
+     * @param file is the source file (empty, if it is still the last one given).
+     */
+    virtual void LINE(int line, std::string file) = 0;
+
     /**
      * Declares that a name is common to other modules.
      *
@@ -682,6 +726,11 @@ namespace cdk {
       return ":function";
     }
 
+    /* global label is a function whose code ends at label end */
+    inline virtual std::string FUNC(const std::string &label, const std::string &end) const {
+      return FUNC() + " (" + end + " - " + label + ")";
+    }
+
     /* global label is data */
     inline virtual std::string OBJ() const {
       return ":object";
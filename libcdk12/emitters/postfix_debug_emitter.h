@@ -32,6 +32,9 @@ namespace cdk {
     void MUL() {
       os() << "MUL\n";
     }
+    void MULHI() {
+      os() << "MULHI\n";
+    }
     void DIV() {
       os() << "DIV\n";
     }
@@ -185,6 +188,18 @@ namespace cdk {
     void POP() {
       os() << "POP\n";
     }
+    void POPR(int n) {
+      os() << "POPR " << n << "\n";
+    }
+    void PUSHR(int n) {
+      os() << "PUSHR " << n << "\n";
+    }
+    void SYSCALL(int args) {
+      os() << "SYSCALL " << args << "\n";
+    }
+    void RDTSC() {
+      os() << "RDTSC\n";
+    }
     void I2D() {
       os() << "I2D\n";
     }
@@ -257,6 +272,12 @@ namespace cdk {
     void GLOBAL(std::string label, std::string type) {
       os() << "GLOBAL " << label << " " << type << "\n";
     }
+    void STATIC(std::string label, std::string type) {
+      os() << "STATIC " << label << " " << type << "\n";
+    }
+    void LINE(int line, std::string file) {
+      os() << "LINE " << line << " " << file << "\n";
+    }
     void LABEL(std::string label) {
       os() << "LABEL " << label << "\n";
     }
@@ -93,6 +93,11 @@ namespace cdk {
     void _push(std::string what) {
       __cmd1("push", what);
     }
+    // argument registers (POPR/PUSHR): none of them is kept across calls
+    std::string argreg(int n) {
+      static const char *regs[] = { "eax", "ecx", "edx" };
+      return regs[n];
+    }
     void _mov(std::string a, std::string b) {
       __cmd2("mov", a, b);
     }
@@ -205,6 +210,12 @@ namespace cdk {
       _imul(_dword("eax"), _deref("esp"));
       _mov(_deref("esp"), "eax");
     }
+    void MULHI() {
+      debug("MULHI");
+      _pop("eax");
+      os() << "\timul\tdword [esp]\n";
+      _mov(_deref("esp"), "edx");
+    }
     void DIV() {
       debug("DIV");
       _pop("ecx");
@@ -495,6 +506,33 @@ namespace cdk {
       debug("POP");
       _pop("eax");
     }
+    void POPR(int n) {
+      debug("POPR", n);
+      _pop(argreg(n));
+    }
+    void PUSHR(int n) {
+      debug("PUSHR", n);
+      _push(argreg(n));
+    }
+    void SYSCALL(int args) {
+      debug("SYSCALL", args);
+      _pop("eax");
+      if (args > 0) os() << "\txchg\tebx, [esp]\n";   // ebx belongs to the caller: kept in the first slot
+      if (args > 1) _mov("ecx", _deref("esp", 4));
+      if (args > 2) _mov("edx", _deref("esp", 8));
+      os() << "\tint\t0x80\n";
+      if (args > 0) _pop("ebx");
+      if (args > 1) _add("esp", 4 * (args - 1));
+      _push("eax");
+    }
+    void RDTSC() {
+      debug("RDTSC");
+      os() << "\trdtsc\n";
+      _push("edx");
+      _push("eax");
+      _fild(_qword(_deref("esp")));
+      _fstp(_qword(_deref("esp")));
+    }
     void DPUSH() {
       debug("DPUSH");
       _sub("esp", _byte(8));
@@ -615,6 +653,14 @@ namespace cdk {
       debug("GLOBAL", label + ", " + type);
       os() << "global\t" << label << type << "\n";
     }
+    void STATIC(std::string label, std::string type) {
+      debug("STATIC", label + ", " + type);
+      os() << "static\t" << label << type << "\n";
+    }
+    void LINE(int line, std::string file) {   // nasm's -g maps the code to it
+      debug("LINE", line);
+      os() << "%line\t" << line << "+0 " << file << "\n";
+    }
     void LABEL(std::string label) {
       debug("LABEL", label);
       os() << label << ":\n";
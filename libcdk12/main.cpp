@@ -1,13 +1,26 @@
+#include <chrono>
+#include <cstdio>
+#include <fstream>
 #include <iostream>
 #include <memory>
+#include <sstream>
 #include <string>
 #include <cdk/compiler.h>
 #include <cdk/basic_factory.h>
+#include <cdk/cache.h>
+#include <cdk/server.h>
+
+// options that are not part of the compiler's state
+static bool report = false;                             // --report
+static std::string cache_dir = getenv("CDK_CACHE_DIR") ? getenv("CDK_CACHE_DIR") : "";
+static size_t cache_size = 256;                         // MB
 
 inline static void usage(const char *progname) {
   std::cerr << "Usage: " << std::endl;
   std::cerr << "\t" << progname
-      << " [-O] [-g] [--tree] [--target output-format] [-o outfile] infile" << std::endl;
+      << " [-O] [-g] [-pg] [-fname[=value]] [--tree] [--target output-format] [-o outfile]"
+      << " [--cache dir] [--cache-size MB] [--report] infile" << std::endl;
+  std::cerr << "\t" << progname << " --server [--report] [socket-path]" << std::endl;
   std::cerr << " -h " << std::endl;
   std::cerr << "\t(if an option is specified multiple times, only the last one is considered)"
       << std::endl;
@@ -35,12 +48,22 @@ inline static void process_options(int argc, char *argv[],
       compiler->optimize(true);
     else if (option == "-g")
       compiler->debug(true);
+    else if (option == "-pg")
+      compiler->set_flag("pg");
+    else if (option.compare(0, 2, "-f") == 0 && option.size() > 2)
+      compiler->set_flag(option.substr(2));
     else if (option == "--tree") {
       compiler->extension("xml");
     } else if (option == "--interpret") {
       compiler->extension("@@INTERPRET@@");
     } else if (option == "--target") {
       compiler->extension(argv[++ax]);
+    } else if (option == "--cache") {
+      cache_dir = argv[++ax];
+    } else if (option == "--cache-size") {
+      cache_size = strtoul(argv[++ax], nullptr, 10);
+    } else if (option == "--report") {
+      report = true;
     } else if (option == "-o") {
       ofile = argv[++ax];
       size_t dot = ofile.find_last_of('.');
@@ -98,23 +121,84 @@ int main(int argc, char *argv[]) {
     exit(1);
   }
 
+  /* ====[ RESIDENT COMPILER: requests from stdin or a socket ]==== */
+  if (argc > 1 && std::string(argv[1]) == "--server") {
+    int ax = 2;
+    if (ax < argc && std::string(argv[ax]) == "--report")
+      report = true, ax++;
+    cdk::server server(language, report);
+    if (ax < argc)
+      return server.listen(argv[ax]);
+    server.serve(std::cin, std::cout);
+    return 0;
+  }
+
   std::shared_ptr<cdk::compiler> compiler = factory->create_compiler();
 
   /* ====[ COMMAND LINE ARGUMENTS ]==== */
   process_options(argc, argv, compiler);
 
+  /* ====[ COMPILATION CACHE ]==== */
+  cdk::cache cache(compiler->ifile() != "" && compiler->ofile() != "" ? cache_dir : "",
+                   cache_size * 1024 * 1024);
+  std::string key;
+  auto clock = std::chrono::steady_clock::now();
+  auto lap = [&clock](const char *phase) {
+    auto now = std::chrono::steady_clock::now();
+    if (report)
+      fprintf(stderr, "   %-10s %10.3f ms\n", phase,
+              std::chrono::duration<double, std::milli>(now - clock).count());
+    clock = now;
+  };
+  auto done = [&cache, &compiler](int status) {
+    if (report)
+      for (auto &remark : compiler->remarks())
+        fprintf(stderr, "   %s\n", remark.c_str());
+    if (report && cache.enabled())
+      fprintf(stderr, "   cache hits: %d, misses: %d (fragments reused: %d, regenerated: %d)\n",
+              cache.hits(), cache.misses(), cache.reused(), cache.regenerated());
+    return status;
+  };
+  if (report)
+    std::cerr << "** Phase report for " << compiler->ifile() << std::endl;
+
+  if (cache.enabled()) {
+    compiler->cache(&cache);
+    std::ifstream ifs(compiler->ifile(), std::ios::binary);
+    std::ostringstream source;
+    source << ifs.rdbuf();
+    if (compiler->flag("profile-use")) {   // the profile read (see -fprofile-use) is input too
+      std::string name = compiler->flag("profile-use", "");
+      if (name == "") name = compiler->ifile().substr(0, compiler->ifile().find_last_of('.')) + ".prof";
+      std::ifstream profile(name, std::ios::binary);
+      source << "\n" << profile.rdbuf();
+    }
+    key = cache.key(language, source.str(), compiler->extension(), compiler->optimize(),
+                    compiler->debug(), compiler->flags());
+    bool hit = cache.fetch(key, compiler->ofile());
+    lap("cache");
+    if (hit) return done(0);
+  }
+
   /* ====[ SYNTACTIC ANALYSIS ]==== */
   if (compiler->parse() != 0 || compiler->errors() > 0) {
     std::cerr << "** Syntax errors in " << compiler->ifile() << std::endl;
-    return 1;
+    return done(1);
   }
+  lap("parse");
 
   /* ====[ SEMANTIC ANALYSIS ]==== */
 
   if (!compiler->evaluate()) {
     std::cerr << "** Semantic errors in " << compiler->ifile() << std::endl;
-    return 1;
+    return done(1);
+  }
+  lap("evaluate");
+
+  if (cache.enabled()) {
+    compiler->scanner()->output_stream()->flush();
+    cache.store(key, compiler->ofile());
   }
 
-  return 0;
+  return done(0);
 }
@@ -0,0 +1,229 @@
+#ifndef __CDK12_SERVER_H__
+#define __CDK12_SERVER_H__
+
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <streambuf>
+#include <string>
+#include <vector>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <cdk/arena.h>
+#include <cdk/compile.h>
+
+namespace cdk {
+
+  /**
+   * Resident compiler (--server). Requests are read one per line:
+   * <pre>
+   *   compile [-O] [-g] [-pg] [-fflag] [--target T] [-o outfile] infile
+   *   source [-O] [-g] [-pg] [-fflag] [--target T] nbytes     (followed by nbytes of program text)
+   *   quit </pre>
+   * Each request is answered with either
+   * <pre>
+   *   ok nbytes                                 (followed by the nbytes of output)
+   *   error ndiagnostics                        (followed by that many "line: message" lines) </pre>
+   * With -o, the output goes to the file instead and the answer is "ok 0".
+   * Other options are answered with an error. Everything a request allocates
+   * for the compilation itself lives in an arena that is reset when the
+   * answer has been sent. With report, the time each compile or source
+   * request took (from reading it to answering it) is written to stderr.
+   *
+   * Clients are trusted like the user running the server: a request reads
+   * and writes any file the compiler can. So the socket is only for its
+   * owner (mode 0600, whatever the umask).
+   */
+  class server {
+    std::string _language;
+    arena _arena;
+    bool _report;
+
+  public:
+    server(const std::string &language, bool report = false) :
+        _language(language), _report(report) {
+    }
+
+  private:
+    static void fail(std::ostream &out, const std::string &message) {
+      out << "error 1\n0: " << message << "\n" << std::flush;
+    }
+
+  public:
+    /** Serves requests until "quit" or end of input. */
+    void serve(std::istream &in, std::ostream &out) {
+      std::string line;
+      while (std::getline(in, line)) {
+        auto start = std::chrono::steady_clock::now();
+        std::istringstream request(line);
+        std::string command, word, target = "asm", ofile, argument;
+        bool optimize = false, debug = false;
+        std::vector<std::string> flags, unknown;
+
+        request >> command;
+        if (command == "") continue;
+        if (command == "quit") break;
+        while (request >> word) {
+          if (word == "-O") optimize = true;
+          else if (word == "-g") debug = true;
+          else if (word == "-pg") flags.push_back("pg");
+          else if (word.compare(0, 2, "-f") == 0 && word.size() > 2) flags.push_back(word.substr(2));
+          else if (word == "--target") request >> target;
+          else if (word == "-o") request >> ofile;
+          else if (word.size() > 1 && word[0] == '-') unknown.push_back(word);
+          else argument = word;
+        }
+
+        std::string source;
+        if (command == "source") {
+          size_t nbytes = strtoul(argument.c_str(), nullptr, 10);
+          source.resize(nbytes);
+          if (!in.read(&source[0], nbytes)) return;
+        } else if (command == "compile") {
+          std::ifstream ifs(argument, std::ios::binary);
+          if (!ifs) {
+            fail(out, "cannot read '" + argument + "'");
+            continue;
+          }
+          std::ostringstream contents;
+          contents << ifs.rdbuf();
+          source = contents.str();
+        } else {
+          fail(out, "unknown request '" + command + "'");
+          continue;
+        }
+        if (!unknown.empty()) {   // after a source request's text, so the next line is a request
+          fail(out, "unknown option '" + unknown.front() + "'");
+          continue;
+        }
+
+        compilation_result result;
+        {
+          arena::scope scope(_arena);
+          result = compile(_language, source, target, optimize, debug, flags);
+        }
+
+        if (!result.ok) {
+          out << "error " << result.diagnostics.size() << "\n";
+          for (auto &d : result.diagnostics)
+            out << d.line << ": " << d.message << "\n";
+        } else if (ofile != "") {
+          std::ofstream ofs(ofile, std::ios::binary);
+          if (!(ofs << result.output)) {
+            fail(out, "cannot write '" + ofile + "'");
+            continue;
+          }
+          out << "ok 0\n";
+        } else
+          out << "ok " << result.output.size() << "\n" << result.output;
+        out.flush();
+        if (_report)
+          fprintf(stderr, "   %-10s %10.3f ms  %s\n", command.c_str(),
+                  std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count(),
+                  command == "compile" ? argument.c_str() : "");
+      }
+    }
+
+  private:
+    /** Minimal stream buffer over a socket descriptor. */
+    class fdbuf: public std::streambuf {
+      int _fd;
+      char _in[4096], _out[4096];
+    public:
+      fdbuf(int fd) :
+          _fd(fd) {
+        setp(_out, _out + sizeof(_out));
+      }
+      ~fdbuf() {
+        sync();
+      }
+    protected:
+      int underflow() {
+        ssize_t n = ::read(_fd, _in, sizeof(_in));
+        if (n <= 0) return traits_type::eof();
+        setg(_in, _in, _in + n);
+        return traits_type::to_int_type(*gptr());
+      }
+      int overflow(int c) {
+        if (sync() != 0) return traits_type::eof();
+        if (c != traits_type::eof()) {
+          *pptr() = c;
+          pbump(1);
+        }
+        return traits_type::not_eof(c);
+      }
+      int sync() {
+        for (char *p = pbase(); p < pptr();) {
+          ssize_t n = ::write(_fd, p, pptr() - p);
+          if (n <= 0) return -1;
+          p += n;
+        }
+        setp(_out, _out + sizeof(_out));
+        return 0;
+      }
+    };
+
+  public:
+    /**
+     * Listens on a Unix domain socket and serves each connection in turn
+     * (a connection is a session, as with stdin).
+     *
+     * Interrupted or aborted connections are retried; other failures to
+     * accept one stop the server.
+     *
+     * @return 0 on orderly shutdown, 1 if the socket cannot be set up or fails
+     */
+    int listen(const std::string &path) {
+      sockaddr_un address;
+      memset(&address, 0, sizeof(address));
+      address.sun_family = AF_UNIX;
+      if (path.size() >= sizeof(address.sun_path)) {
+        std::cerr << "FATAL: socket path too long: " << path << std::endl;
+        return 1;
+      }
+      strcpy(address.sun_path, path.c_str());
+
+      int sock = ::socket(AF_UNIX, SOCK_STREAM, 0);
+      ::unlink(path.c_str());
+      mode_t mask = ::umask(077);   // no moment when others may connect
+      bool bound = sock >= 0 && ::bind(sock, (sockaddr*)&address, sizeof(address)) == 0;
+      ::umask(mask);
+      if (!bound || ::chmod(path.c_str(), 0600) != 0 || ::listen(sock, 16) != 0) {
+        std::cerr << "FATAL: cannot listen on " << path << ": " << strerror(errno) << std::endl;
+        if (sock >= 0) ::close(sock);
+        return 1;
+      }
+
+      int status = 0;
+      for (;;) {
+        int fd = ::accept(sock, nullptr, nullptr);
+        if (fd < 0) {
+          if (errno == EINTR || errno == ECONNABORTED) continue;
+          std::cerr << "FATAL: cannot accept on " << path << ": " << strerror(errno) << std::endl;
+          status = 1;
+          break;
+        }
+        {
+          fdbuf buffer(fd);
+          std::istream in(&buffer);
+          std::ostream out(&buffer);
+          serve(in, out);
+        }
+        ::close(fd);
+      }
+      ::close(sock);
+      ::unlink(path.c_str());
+      return status;
+    }
+
+  };
+
+} // cdk
+
+#endif
@@ -6,7 +6,8 @@
 
 /**
  * This is the external parsing function.
- * It is automatically generated by 'byacc'
+ * It is automatically generated by 'byacc' (as a pure, i.e., re-entrant, parser:
+ * all parsing state lives in the function's activation record).
  */
 extern int yyparse(std::shared_ptr<cdk::compiler> compiler);
 
@@ -26,7 +27,7 @@ namespace cdk {
     }
 
     int parse() {
-      return ::yyparse(_compiler);
+      return ::yyparse(owner());
     }
 
   };
@@ -17,6 +17,10 @@ namespace cdk {
         basic_scanner(language), _lexer(new LexerType(nullptr, nullptr)) {
     }
 
+    inline ~yy_scanner() {
+      delete _lexer;
+    }
+
   public:
     inline LexerType *lexer() {
       return _lexer;
@@ -41,7 +45,11 @@ namespace cdk {
      * Scan the input.
      */
     int scan() {
-      return _lexer->yylex();
+      basic_scanner *outer = current();
+      current() = this;
+      int token = _lexer->yylex();
+      current() = outer;
+      return token;
     }
 
     /**
@@ -0,0 +1,370 @@
+/*
+ * The XPL runtime (see rts.h), for Linux on i386. It needs no C library:
+ * it makes its system calls itself and starts the program (_start).
+ */
+
+#include <stdarg.h>
+#include "rts.h"
+
+#define SYS_EXIT  1
+#define SYS_READ  3
+#define SYS_WRITE 4
+#define SYS_OPEN  5
+#define SYS_CLOSE 6
+#define SYS_IOCTL 54
+#define TCGETS    0x5401
+#define EINTR     4
+
+static int syscall3(int number, int a, int b, int c) {
+  int result;
+  __asm__ volatile("int $0x80" : "=a"(result) : "a"(number), "b"(a), "c"(b), "d"(c) : "memory");
+  return result;
+}
+
+/*---------------------------------------------------------------------------
+ * output
+ *---------------------------------------------------------------------------*/
+
+#define OUTPUT 65536
+
+static char _output[OUTPUT];
+static int _used;        /* bytes of _output waiting to be written */
+static int _tty;         /* stdout is a terminal: write at each newline */
+
+static void put(int fd, const char *bytes, int size) {
+  while (size > 0) {
+    int written = syscall3(SYS_WRITE, fd, (int)bytes, size);
+    if (written == -EINTR) continue;
+    if (written <= 0) return;  /* nowhere to write: drop it */
+    bytes += written;
+    size -= written;
+  }
+}
+
+static void flush(void) {
+  put(1, _output, _used);
+  _used = 0;
+}
+
+/* Room for size more bytes (size <= OUTPUT). */
+static char *reserve(int size) {
+  if (_used + size > OUTPUT) flush();
+  return _output + _used;
+}
+
+static void append(const char *bytes, int size) {
+  if (_used + size > OUTPUT) {
+    flush();
+    if (size > OUTPUT / 2) {  /* big ones go straight out */
+      put(1, bytes, size);
+      return;
+    }
+  }
+  char *to = _output + _used;
+  for (int i = 0; i < size; i++)
+    to[i] = bytes[i];
+  _used += size;
+}
+
+void prints(const char *text) {
+  int newline = 0;
+  while (*text) {
+    char *to = reserve(1), *end = _output + OUTPUT;
+    while (*text && to < end) {
+      newline |= *text == '\n';
+      *to++ = *text++;
+    }
+    _used = to - _output;
+  }
+  if (newline && _tty) flush();
+}
+
+void println(void) {
+  *reserve(1) = '\n';
+  _used++;
+  if (_tty) flush();
+}
+
+static const char _pairs[] =
+  "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+  "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+  "8081828384858687888990919293949596979899";
+
+/* Writes value's digits ending at end (at least width of them): @return where they start */
+static char *digits(char *end, unsigned value, int width) {
+  char *p = end;
+  while (value >= 100) {
+    const char *pair = _pairs + 2 * (value % 100);
+    value /= 100;
+    *--p = pair[1];
+    *--p = pair[0];
+  }
+  if (value >= 10) {
+    *--p = _pairs[2 * value + 1];
+    *--p = _pairs[2 * value];
+  } else {
+    *--p = '0' + value;
+  }
+  while (end - p < width)
+    *--p = '0';
+  return p;
+}
+
+void printi(int value) {
+  char buffer[12], *end = buffer + sizeof(buffer);
+  char *p = digits(end, value < 0 ? -(unsigned)value : (unsigned)value, 0);
+  if (value < 0) *--p = '-';
+  append(p, end - p);
+}
+
+static const double _powers[] = {
+  1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+  1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+/* value * 10^exponent: exact when both value and 10^exponent are (|exponent| <= 22) */
+static double scale(double value, int exponent) {
+  for (; exponent > 22; exponent -= 22)
+    value *= 1e22;
+  for (; exponent < -22; exponent += 22)
+    value /= 1e22;
+  return exponent < 0 ? value / _powers[-exponent] : value * _powers[exponent];
+}
+
+/* Integral part of a non-negative real (without the C library's trunc). */
+static double whole(double value) {
+  if (value >= 4503599627370496.0) return value;  /* 2^52: no fraction bits left */
+  return (double)(long long)value;
+}
+
+/* Writes the digits of a whole non-negative real ending at end: @return where they start.
+ * Past 2^53 (where not all integers are reals), only the first 16 digits are
+ * significant and the others are written as zeros. */
+static char *whole_digits(char *end, double value) {
+  if (value < 4294967296.0) return digits(end, (unsigned)value, 0);
+  int zeros = 0;
+  for (double v = value; v >= 9007199254740992.0; v /= 10)
+    zeros++;
+  if (zeros > 0) {
+    value = whole(scale(value, -zeros) + 0.5);
+    for (int i = 0; i < zeros; i++)
+      *--end = '0';
+  }
+  double high = whole(value / 1e9), low = value - high * 1e9;  /* exact, but for high's rounding */
+  if (low < 0) high -= 1, low += 1e9;
+  else if (low >= 1e9) high += 1, low -= 1e9;
+  return whole_digits(digits(end, (unsigned)low, 9), high);
+}
+
+void printd(double value) {
+  if (value != value) {
+    append("nan", 3);
+    return;
+  }
+  char buffer[330], *end = buffer + sizeof(buffer);
+  int negative = value < 0;
+  if (negative) value = -value;
+  char *p;
+  if (value > 1.7976931348623157e308) {
+    p = end - 3;
+    p[0] = 'i', p[1] = 'n', p[2] = 'f';
+  } else {
+    double integral = whole(value);
+    unsigned fraction = (unsigned)((value - integral) * 1e6 + 0.5);
+    if (fraction >= 1000000) {  /* rounded up to the next unit */
+      fraction -= 1000000;
+      integral += 1;
+    }
+    p = digits(end, fraction, 6);
+    *--p = '.';
+    p = whole_digits(p, integral);
+  }
+  if (negative) *--p = '-';
+  append(p, end - p);
+}
+
+void __xpl_print(const char *format, ...) {
+  va_list values;
+  va_start(values, format);
+  int newline = 0;
+  while (*format) {
+    if (format[0] == '\1' && format[1] != '\1') {
+      char kind = format[1];
+      if (kind == 'i') printi(va_arg(values, int));
+      else if (kind == 'd') printd(va_arg(values, double));
+      else if (kind == 's') prints(va_arg(values, const char *));
+      else break;
+      format += 2;
+      continue;
+    }
+    if (*format == '\1') format++;
+    newline |= *format == '\n';
+    *reserve(1) = *format++;
+    _used++;
+  }
+  va_end(values);
+  if (newline && _tty) flush();
+}
+
+/*---------------------------------------------------------------------------
+ * input
+ *---------------------------------------------------------------------------*/
+
+#define INPUT 65536
+
+static char _input[INPUT];
+static int _next, _read;  /* the next byte of _input, and the end of what was read */
+
+/* @return the next byte of the input (without taking it), or -1 at its end */
+static int peek(void) {
+  if (_next == _read) {
+    if (_tty) flush();  /* the prompt, if any */
+    int size;
+    do size = syscall3(SYS_READ, 0, (int)_input, INPUT);
+    while (size == -EINTR);
+    _next = 0;
+    _read = size > 0 ? size : 0;
+    if (_read == 0) return -1;
+  }
+  return (unsigned char)_input[_next];
+}
+
+/* Skips blanks: @return whether what follows is negative (taking its sign, if any) */
+static int sign(void) {
+  int c;
+  while ((c = peek()) == ' ' || c == '\n' || c == '\t' || c == '\r' || c == '\v' || c == '\f')
+    _next++;
+  if (c == '-' || c == '+') _next++;
+  return c == '-';
+}
+
+int readi(void) {
+  int negative = sign(), c;
+  unsigned value = 0;
+  while ((c = peek()) >= '0' && c <= '9') {
+    value = value * 10 + (c - '0');
+    _next++;
+  }
+  return negative ? -(int)value : (int)value;
+}
+
+double readd(void) {
+  int negative = sign(), exponent = 0, c;
+  long long mantissa = 0;  /* the first 18 significant digits; the others only count */
+  while ((c = peek()) >= '0' && c <= '9') {
+    if (mantissa < 100000000000000000LL) mantissa = mantissa * 10 + (c - '0');
+    else exponent++;
+    _next++;
+  }
+  if (c == '.') {
+    _next++;
+    while ((c = peek()) >= '0' && c <= '9') {
+      if (mantissa < 100000000000000000LL) {
+        mantissa = mantissa * 10 + (c - '0');
+        exponent--;
+      }
+      _next++;
+    }
+  }
+  if (c == 'e' || c == 'E') {
+    _next++;
+    int minus = 0, power = 0;
+    if ((c = peek()) == '-' || c == '+') {
+      minus = c == '-';
+      _next++;
+    }
+    while ((c = peek()) >= '0' && c <= '9') {
+      if (power < 100000) power = power * 10 + (c - '0');
+      _next++;
+    }
+    exponent += minus ? -power : power;
+  }
+  double value = mantissa == 0 ? 0.0 : scale((double)mantissa, exponent);
+  return negative ? -value : value;
+}
+
+/*---------------------------------------------------------------------------
+ * profile (-pg)
+ *---------------------------------------------------------------------------*/
+
+static const char _pg_header[] = "  %self   self kcycles  total kcycles       calls  name\n";
+
+/* Writes value rounded (negative or too big as 0) in decimal, ending at end. */
+static void column(char *end, double value) {
+  digits(end, value >= 0 && value < 2147483647.5 ? (unsigned)(value + 0.5) : 0, 0);
+}
+
+void __xpl_pg_report(const char *file, struct __xpl_pg_record *head) {
+  double sum = 0;  /* of the self cycles, for the percentages */
+  for (struct __xpl_pg_record *r = head; r; r = r->next)
+    sum += r->self;
+
+  int fd = syscall3(SYS_OPEN, (int)file, 01 | 0100 | 01000, 0644);  /* O_WRONLY | O_CREAT | O_TRUNC */
+  if (fd < 0) return;
+  put(fd, _pg_header, sizeof(_pg_header) - 1);
+  for (;;) {       /* the most self cycles first; those written get -1 */
+    struct __xpl_pg_record *best = 0;
+    for (struct __xpl_pg_record *r = head; r; r = r->next)
+      if (r->self >= 0 && (best == 0 || r->self > best->self)) best = r;
+    if (best == 0) break;
+
+    char line[50];
+    for (int i = 0; i < 50; i++)
+      line[i] = ' ';
+    column(line + 7, sum > 0 ? best->self * 100 / sum : 0);
+    column(line + 21, best->self / 1000);
+    column(line + 36, best->total / 1000);
+    column(line + 48, best->calls);
+    put(fd, line, sizeof(line));
+    int length = 0;
+    while (best->name[length])
+      length++;
+    put(fd, best->name, length);
+    put(fd, "\n", 1);
+    best->self = -1;
+  }
+  syscall3(SYS_CLOSE, fd, 0, 0);
+}
+
+/*---------------------------------------------------------------------------
+ * program
+ *---------------------------------------------------------------------------*/
+
+static int _argc;
+static char **_argv, **_envp;
+
+int argc(void) {
+  return _argc;
+}
+
+char *argv(int n) {
+  return _argv[n];
+}
+
+char *envp(int n) {
+  return _envp[n];
+}
+
+extern int _main(void);
+
+/* Called by _start with the initial stack: argc, the arguments, 0, the environment, 0. */
+void __xpl_start(int *stack) {
+  char termios[64];
+  _argc = stack[0];
+  _argv = (char **)(stack + 1);
+  _envp = _argv + _argc + 1;
+  _tty = syscall3(SYS_IOCTL, 1, TCGETS, (int)termios) == 0;
+  int status = _main();
+  flush();
+  syscall3(SYS_EXIT, status, 0, 0);
+}
+
+__asm__(
+  ".globl _start\n"
+  "_start:\n"
+  "  movl %esp, %eax\n"
+  "  andl $-16, %esp\n"
+  "  subl $12, %esp\n"
+  "  pushl %eax\n"
+  "  call __xpl_start\n"
+);
@@ -0,0 +1,71 @@
+#ifndef __XPL_RTS_H__
+#define __XPL_RTS_H__
+
+/*
+ * The XPL runtime: what compiled programs call (see the EXTERNs at the end
+ * of postfix_writer::do_sequence_node) and their entry point, which runs
+ * xpl (_main) and exits with its value. Programs are linked with it:
+ *
+ *   ld -m elf_i386 -o prog prog.o -L$(ROOT)/usr/lib -lrts
+ *
+ * Output is buffered and written when the buffer fills, before reading
+ * input and when xpl returns; when stdout is a terminal, also at each
+ * newline. Input is read in blocks.
+ */
+
+/** Reads an int (decimal, with an optional sign); 0 when there is none. */
+int readi(void);
+
+/** Reads a real (decimal, with optional sign, fraction and exponent); 0 when there is none. */
+double readd(void);
+
+/** Prints an int, in decimal. */
+void printi(int value);
+
+/** Prints a real, with six decimal places (like printf's %f). */
+void printd(double value);
+
+/** Prints a string. */
+void prints(const char *text);
+
+/** Prints a newline. */
+void println(void);
+
+/**
+ * Prints the text of format and, where it has a directive (byte 1 and a
+ * letter), the next value: 'i' an int, 'd' a real and 's' a string (as
+ * printi, printd and prints would). Byte 1 twice is the byte itself. The
+ * compiler makes one call of consecutive prints with -O or -fcoalesce-prints
+ * (see targets/print_format.h).
+ */
+void __xpl_print(const char *format, ...);
+
+/**
+ * What -pg keeps for each function (see targets/pg_hooks.h): the compiler
+ * lays records out like this and links those of the functions that ran
+ * from _pg.head.
+ */
+struct __xpl_pg_record {
+  struct __xpl_pg_record *next;
+  const char *name;
+  int calls;
+  double self, total;      /* cycles, without and with the callees' */
+  int running;             /* calls that have not returned */
+};
+
+/**
+ * Writes the flat profile of the records to file (called when xpl returns,
+ * with -pg): a line for each, the one with the most self cycles first.
+ */
+void __xpl_pg_report(const char *file, struct __xpl_pg_record *head);
+
+/** @return the number of command line arguments, including the program's name */
+int argc(void);
+
+/** @return the n-th command line argument */
+char *argv(int n);
+
+/** @return the n-th environment variable (name=value), or null after the last */
+char *envp(int n);
+
+#endif
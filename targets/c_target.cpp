@@ -0,0 +1,4 @@
+#include "targets/c_target.h"
+
+/** @var create and register the C target (the program translated to C). */
+xpl::c_target xpl::c_target::_self;
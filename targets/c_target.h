@@ -0,0 +1,36 @@
+#ifndef __XPL_SEMANTICS_C_TARGET_H__
+#define __XPL_SEMANTICS_C_TARGET_H__
+
+#include <cdk/basic_target.h>
+#include <cdk/symbol_table.h>
+#include <cdk/ast/basic_node.h>
+#include <cdk/compiler.h>
+#include "targets/c_writer.h"
+#include "targets/symbol.h"
+
+namespace xpl {
+
+  class c_target: public cdk::basic_target {
+    static c_target _self;
+
+  private:
+    inline c_target() :
+        cdk::basic_target("c") {
+    }
+
+  public:
+    bool evaluate(std::shared_ptr<cdk::compiler> compiler) {
+      // this symbol table will be used to check identifiers
+      // during translation
+      cdk::symbol_table<xpl::symbol> symtab;
+
+      c_writer writer(compiler, symtab);
+      compiler->ast()->accept(&writer, 0);
+      return compiler->errors() == 0;
+    }
+
+  };
+
+} // xpl
+
+#endif
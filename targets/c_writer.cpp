@@ -0,0 +1,604 @@
+#include <iomanip>
+#include <set>
+#include <string>
+#include <sstream>
+#include "targets/type_checker.h"
+#include "targets/c_writer.h"
+#include "targets/call_graph.h"
+#include "ast/all.h"  // all.h is automatically generated
+
+//---------------------------------------------------------------------------
+
+// what every translation starts with (it needs no C library, only the RTS): alloca,
+// the RTS and the identity operator (see do_identity_node)
+static const char *prelude =
+  "#include <stddef.h>\n"
+  "#ifdef __GNUC__\n"
+  "#define alloca __builtin_alloca\n"
+  "#else\n"
+  "#include <alloca.h>\n"
+  "#endif\n"
+  "\n"
+  "/* addresses are ints: build for 32 bits (-m32), like the RTS */\n"
+  "_Static_assert(sizeof(void *) == sizeof(int), \"compile with -m32\");\n"
+  "\n"
+  "extern int readi(void);\n"
+  "extern double readd(void);\n"
+  "extern void printi(int);\n"
+  "extern void printd(double);\n"
+  "extern void prints(char *);\n"
+  "extern void println(void);\n"
+  "\n"
+  "static inline int xpl_abs(int value) { return value <= 0 ? -value : value; }\n"
+  "static inline double xpl_fabs(double value) { return value <= 0 ? -value : value; }\n";
+
+// the result of the function being written (its name, in XPL)
+static const std::string result = "_result";
+
+// a C string literal with the given contents
+static std::string quote(const std::string &text) {
+  std::ostringstream oss;
+  oss << '"';
+  for (unsigned char c : text) {
+    if (c == '"' || c == '\\' || c == '?')
+      oss << '\\' << c;
+    else if (c < ' ' || c > '~')  // always three digits: a digit after it is not part of it
+      oss << '\\' << std::oct << std::setw(3) << std::setfill('0') << (int)c << std::dec;
+    else
+      oss << c;
+  }
+  oss << '"';
+  return oss.str();
+}
+
+std::string xpl::c_writer::name(const std::string &id) {
+  static const std::set<std::string> reserved = {
+    "auto", "break", "case", "char", "const", "continue", "default", "do", "double", "else",
+    "enum", "extern", "float", "for", "goto", "if", "inline", "int", "long", "register",
+    "restrict", "return", "short", "signed", "sizeof", "static", "struct", "switch",
+    "typedef", "union", "unsigned", "void", "volatile", "while", "_Bool", "_Complex",
+    "_Imaginary", "_Alignas", "_Alignof", "_Atomic", "_Generic", "_Noreturn",
+    "_Static_assert", "_Thread_local", "main", "_main", "alloca", "ptrdiff_t",
+    "xpl_abs", "xpl_fabs", result
+  };
+  return reserved.count(id) ? id + "_" : id;
+}
+
+std::string xpl::c_writer::ctype(basic_type *type) {
+  switch (type->name()) {
+    case basic_type::TYPE_INT:
+      return "int";
+    case basic_type::TYPE_DOUBLE:
+      return "double";
+    case basic_type::TYPE_STRING:
+      return "char *";
+    case basic_type::TYPE_POINTER: {
+      std::string target = type->subtype() ? ctype(type->subtype()) : "void";
+      return target + (target.back() == '*' ? "*" : " *");
+    }
+    default:
+      return "void";
+  }
+}
+
+std::string xpl::c_writer::declare(basic_type *type, const std::string &name) {
+  std::string t = ctype(type);
+  return t + (t.back() == '*' ? "" : " ") + name;
+}
+
+void xpl::c_writer::expression(cdk::expression_node * const node, int lvl) {
+  if (node == nullptr)  // null
+    os() << "0";
+  else
+    node->accept(this, lvl);
+}
+
+void xpl::c_writer::convert(cdk::expression_node * const node, basic_type *type, int lvl) {
+  if (node == nullptr || node->type() == nullptr) {
+    expression(node, lvl);
+    return;
+  }
+  basic_type::type from = node->type()->name(), to = type->name();
+  bool fromref = from == basic_type::TYPE_POINTER || from == basic_type::TYPE_STRING;
+  bool toref = to == basic_type::TYPE_POINTER || to == basic_type::TYPE_STRING;
+
+  if (toref && from == basic_type::TYPE_INT)
+    os() << "((" << ctype(type) << ") (ptrdiff_t) ";
+  else if (to == basic_type::TYPE_INT && fromref)
+    os() << "((int) (ptrdiff_t) ";
+  else if (toref && fromref && ctype(node->type()) != ctype(type))
+    os() << "((" << ctype(type) << ") ";
+  else {
+    expression(node, lvl);
+    return;
+  }
+  expression(node, lvl);
+  os() << ")";
+}
+
+void xpl::c_writer::binary(cdk::binary_expression_node * const node, const char *op, int lvl) {
+  os() << "(";
+  expression(node->left(), lvl + 2);
+  os() << " " << op << " ";
+  expression(node->right(), lvl + 2);
+  os() << ")";
+}
+
+void xpl::c_writer::compare(cdk::binary_expression_node * const node, const char *op, int lvl) {
+  basic_type *left = node->left() ? node->left()->type() : nullptr;
+  basic_type *right = node->right() ? node->right()->type() : nullptr;
+  if (left == nullptr || right == nullptr || ctype(left) == ctype(right)) {
+    binary(node, op, lvl);
+    return;
+  }
+  basic_type integer(4, basic_type::TYPE_INT);
+  os() << "(";
+  convert(node->left(), &integer, lvl + 2);
+  os() << " " << op << " ";
+  convert(node->right(), &integer, lvl + 2);
+  os() << ")";
+}
+
+void xpl::c_writer::parameters(cdk::sequence_node * const args, int lvl) {
+  os() << "(";
+  size_t n = 0;
+  _argdcl = true;
+  for (size_t i = 0; args != nullptr && i < args->size(); i++) {
+    if (args->node(i) == nullptr) continue;
+    if (n++ > 0) os() << ", ";
+    args->node(i)->accept(this, lvl + 2);
+  }
+  _argdcl = false;
+  os() << (n == 0 ? "void)" : ")");
+}
+
+void xpl::c_writer::body(cdk::basic_node * const node, int lvl) {
+  os() << "{" << std::endl;
+  _depth++;
+  if (auto block = dynamic_cast<xpl::block_node*>(node))
+    contents(block, lvl);
+  else if (node != nullptr)
+    node->accept(this, lvl + 2);
+  _depth--;
+  os() << indent() << "}";
+}
+
+void xpl::c_writer::contents(xpl::block_node * const node, int lvl) {
+  _symtab.push();
+  if (node->declarations()) node->declarations()->accept(this, lvl + 2);
+  if (node->instructions()) node->instructions()->accept(this, lvl + 2);
+  _symtab.pop();
+}
+
+void xpl::c_writer::line(cdk::basic_node * const node) {
+  if (debug()) os() << "#line " << node->lineno() << " " << quote(_compiler->ifile()) << std::endl;
+}
+
+//---------------------------------------------------------------------------
+
+void xpl::c_writer::do_sequence_node(cdk::sequence_node * const node, int lvl) {
+  if (lvl == 0) {
+    _external = xpl::external_functions(node);
+    os() << "/* " << (_compiler->ifile() == "" ? "xpl" : _compiler->ifile())
+         << ", translated by the xpl compiler */" << std::endl << prelude;
+  }
+  for (size_t i = 0; i < node->size(); i++)
+    if (node->node(i) != nullptr) node->node(i)->accept(this, lvl + 2);
+}
+
+//------------ LITERALS ------------------------------------------------------
+
+void xpl::c_writer::do_integer_node(cdk::integer_node * const node, int lvl) {
+  os() << node->value();
+}
+
+void xpl::c_writer::do_double_node(cdk::double_node * const node, int lvl) {
+  std::ostringstream oss;
+  oss << std::setprecision(17) << node->value();
+  std::string text = oss.str();
+  if (text.find_first_of(".eni") == std::string::npos) text += ".0";  // a double, not an int
+  os() << text;
+}
+
+void xpl::c_writer::do_string_node(cdk::string_node * const node, int lvl) {
+  os() << quote(node->value());
+}
+
+//------------ UNARY EXPRESSIONS ---------------------------------------------
+
+void xpl::c_writer::do_neg_node(cdk::neg_node * const node, int lvl) {
+  ASSERT_SAFE_EXPRESSIONS;
+  os() << "(-";
+  expression(node->argument(), lvl + 2);
+  os() << ")";
+}
+
+void xpl::c_writer::do_not_node(cdk::not_node * const node, int lvl) {
+  ASSERT_SAFE_EXPRESSIONS;
+  os() << "(~";  // as in the native code, the one's complement
+  expression(node->argument(), lvl + 2);
+  os() << ")";
+}
+
+void xpl::c_writer::do_identity_node(xpl::identity_node * const node, int lvl) {
+  ASSERT_SAFE_EXPRESSIONS;
+  // as in the native code, the absolute value
+  os() << (node->type()->name() == basic_type::TYPE_DOUBLE ? "xpl_fabs(" : "xpl_abs(");
+  expression(node->argument(), lvl + 2);
+  os() << ")";
+}
+
+void xpl::c_writer::do_memalloc_node(xpl::memalloc_node * const node, int lvl) {
+  ASSERT_SAFE_EXPRESSIONS;
+  basic_type *type = node->type();
+  std::string element = type->name() == basic_type::TYPE_POINTER && type->subtype() ?
+                        ctype(type->subtype()) : "char";
+  os() << "((" << ctype(type) << ") alloca(sizeof(" << element << ") * ";
+  expression(node->argument(), lvl + 2);
+  os() << "))";
+}
+
+void xpl::c_writer::do_address_node(xpl::address_node * const node, int lvl) {
+  ASSERT_SAFE_EXPRESSIONS;
+  os() << "((int) (ptrdiff_t) &";
+  expression(node->argument(), lvl + 2);
+  os() << ")";
+}
+
+//------------ BINARY EXPRESSIONS --------------------------------------------
+
+void xpl::c_writer::do_add_node(cdk::add_node * const node, int lvl) {
+  ASSERT_SAFE_EXPRESSIONS;
+  binary(node, "+", lvl);
+}
+
+void xpl::c_writer::do_sub_node(cdk::sub_node * const node, int lvl) {
+  ASSERT_SAFE_EXPRESSIONS;
+  basic_type *left = node->left()->type(), *right = node->right()->type();
+  if (left->name() == basic_type::TYPE_POINTER && right->name() == basic_type::TYPE_POINTER) {
+    // as in the native code, the number of the left one's elements between them
+    os() << "((int) (";
+    expression(node->left(), lvl + 2);
+    os() << " - ";
+    convert(node->right(), left, lvl + 2);
+    os() << "))";
+    return;
+  }
+  binary(node, "-", lvl);
+}
+
+void xpl::c_writer::do_mul_node(cdk::mul_node * const node, int lvl) {
+  ASSERT_SAFE_EXPRESSIONS;
+  binary(node, "*", lvl);
+}
+
+void xpl::c_writer::do_div_node(cdk::div_node * const node, int lvl) {
+  ASSERT_SAFE_EXPRESSIONS;
+  binary(node, "/", lvl);
+}
+
+void xpl::c_writer::do_mod_node(cdk::mod_node * const node, int lvl) {
+  ASSERT_SAFE_EXPRESSIONS;
+  binary(node, "%", lvl);
+}
+
+void xpl::c_writer::do_lt_node(cdk::lt_node * const node, int lvl) {
+  ASSERT_SAFE_EXPRESSIONS;
+  compare(node, "<", lvl);
+}
+
+void xpl::c_writer::do_le_node(cdk::le_node * const node, int lvl) {
+  ASSERT_SAFE_EXPRESSIONS;
+  compare(node, "<=", lvl);
+}
+
+void xpl::c_writer::do_ge_node(cdk::ge_node * const node, int lvl) {
+  ASSERT_SAFE_EXPRESSIONS;
+  compare(node, ">=", lvl);
+}
+
+void xpl::c_writer::do_gt_node(cdk::gt_node * const node, int lvl) {
+  ASSERT_SAFE_EXPRESSIONS;
+  compare(node, ">", lvl);
+}
+
+void xpl::c_writer::do_ne_node(cdk::ne_node * const node, int lvl) {
+  ASSERT_SAFE_EXPRESSIONS;
+  compare(node, "!=", lvl);
+}
+
+void xpl::c_writer::do_eq_node(cdk::eq_node * const node, int lvl) {
+  ASSERT_SAFE_EXPRESSIONS;
+  compare(node, "==", lvl);
+}
+
+void xpl::c_writer::do_and_node(cdk::and_node * const node, int lvl) {
+  ASSERT_SAFE_EXPRESSIONS;
+  binary(node, "&&", lvl);
+}
+
+void xpl::c_writer::do_or_node(cdk::or_node * const node, int lvl) {
+  ASSERT_SAFE_EXPRESSIONS;
+  binary(node, "||", lvl);
+}
+
+//------------ EXPRESSIONS ---------------------------------------------------
+
+void xpl::c_writer::do_identifier_node(cdk::identifier_node * const node, int lvl) {
+  ASSERT_SAFE_EXPRESSIONS;
+  auto symbol = _symtab.find(node->name());
+  // as in the native code, a function's name is the result of the one being written
+  os() << (symbol != nullptr && symbol->fn() ? result : name(node->name()));
+}
+
+void xpl::c_writer::do_rvalue_node(cdk::rvalue_node * const node, int lvl) {
+  ASSERT_SAFE_EXPRESSIONS;
+  node->lvalue()->accept(this, lvl + 2);
+}
+
+void xpl::c_writer::do_assignment_node(cdk::assignment_node * const node, int lvl) {
+  ASSERT_SAFE_EXPRESSIONS;
+  os() << "(";
+  node->lvalue()->accept(this, lvl + 2);
+  os() << " = ";
+  convert(node->rvalue(), node->lvalue()->type(), lvl + 2);
+  os() << ")";
+}
+
+void xpl::c_writer::do_funcall_node(xpl::funcall_node * const node, int lvl) {
+  ASSERT_SAFE_EXPRESSIONS;
+  const std::string &id = *node->name();
+  std::vector<basic_type> params = _symtab.find(id)->getArgs();
+
+  os() << (id == "xpl" ? "_main" : name(id)) << "(";
+  for (size_t i = 0; node->argument() != nullptr && i < node->argument()->size(); i++) {
+    auto arg = dynamic_cast<cdk::expression_node*>(node->argument()->node(i));
+    if (i > 0) os() << ", ";
+    if (i < params.size())
+      convert(arg, &params[i], lvl + 2);
+    else
+      expression(arg, lvl + 2);
+  }
+  os() << ")";
+}
+
+void xpl::c_writer::do_index_node(xpl::index_node * const node, int lvl) {
+  ASSERT_SAFE_EXPRESSIONS;
+  os() << "(";
+  expression(node->expression(), lvl + 2);
+  os() << ")[";
+  expression(node->shift(), lvl + 2);
+  os() << "]";
+}
+
+void xpl::c_writer::do_read_node(xpl::read_node * const node, int lvl) {
+  ASSERT_SAFE_EXPRESSIONS;
+  os() << (node->type()->name() == basic_type::TYPE_DOUBLE ? "readd()" : "readi()");
+}
+
+//------------ BASIC NODES ---------------------------------------------------
+
+void xpl::c_writer::do_body_node(xpl::body_node * const node, int lvl) {
+  if (node->declarations()) node->declarations()->accept(this, lvl + 2);
+  if (node->instructions()) node->instructions()->accept(this, lvl + 2);
+}
+
+void xpl::c_writer::do_block_node(xpl::block_node * const node, int lvl) {
+  line(node);
+  os() << indent();
+  body(node, lvl);
+  os() << std::endl;
+}
+
+void xpl::c_writer::do_evaluation_node(xpl::evaluation_node * const node, int lvl) {
+  ASSERT_SAFE_EXPRESSIONS;
+  line(node);
+  os() << indent();
+  expression(node->argument(), lvl + 2);
+  os() << ";" << std::endl;
+}
+
+void xpl::c_writer::do_function_node(xpl::function_node * const node, int lvl) {
+  ASSERT_SAFE_EXPRESSIONS;
+
+  const std::string &id = *node->name();
+  auto symbol = _symtab.find(id);
+  if (symbol == nullptr) {
+    symbol = std::make_shared<xpl::symbol>(node->toImport(), true, true, true, node->type(), id, 0);
+    _symtab.insert(id, symbol);
+  }
+  if (node->argument() != nullptr && symbol->getArgs().empty()) {
+    for (size_t i = 0; i < node->argument()->size(); i++) {
+      auto decl = dynamic_cast<xpl::decl_variable_node*>(node->argument()->node(i));
+      if (decl != nullptr) symbol->addArg(*decl->type());
+    }
+  }
+  bool procedure = _procedure = node->type()->name() == basic_type::TYPE_VOID;
+
+  os() << std::endl;
+  line(node);
+  os() << (_external.count(id) ? "" : "static ")
+       << declare(node->type(), id == "xpl" ? "_main" : name(id));
+  _infn = true;
+  _symtab.push();
+  parameters(node->argument(), lvl);
+  os() << " {" << std::endl;
+  _depth++;
+
+  if (!procedure) {   // the function's name is its result (see do_identifier_node)
+    os() << indent() << declare(node->type(), result) << " = ";
+    convert(node->literal(), node->type(), lvl + 2);
+    os() << ";" << std::endl;
+  }
+  node->body()->accept(this, lvl + 2);
+  if (!procedure) os() << indent() << "return " << result << ";" << std::endl;
+
+  _depth--;
+  os() << "}" << std::endl;
+  _symtab.pop();
+  _infn = false;
+}
+
+void xpl::c_writer::do_next_node(xpl::next_node * const node, int lvl) {
+  if (_loops == 0) {
+    _compiler->error(node->lineno(), "Next outside loop.");
+    return;
+  }
+  line(node);
+  os() << indent() << "continue;" << std::endl;
+}
+
+void xpl::c_writer::do_print_node(xpl::print_node * const node, int lvl) {
+  ASSERT_SAFE_EXPRESSIONS;
+
+  basic_type::type argtype = node->argument()->type()->name();
+  auto sub = dynamic_cast<cdk::sub_node*>(node->argument());
+  if (sub != nullptr && sub->left()->type()->name() == basic_type::TYPE_POINTER &&
+      sub->right()->type()->name() == basic_type::TYPE_POINTER)
+    argtype = basic_type::TYPE_INT;   // a number of elements (see do_sub_node)
+  const char *printer = argtype == basic_type::TYPE_INT ? "printi" :
+                        argtype == basic_type::TYPE_DOUBLE ? "printd" :
+                        argtype == basic_type::TYPE_STRING ? "prints" : nullptr;
+  if (printer == nullptr) {
+    _compiler->error(node->lineno(), "Print error: Can't print this type");
+    return;
+  }
+
+  line(node);
+  os() << indent() << printer << "(";
+  expression(node->argument(), lvl + 2);
+  os() << ");";
+  if (node->newline()) os() << " println();";
+  os() << std::endl;
+}
+
+void xpl::c_writer::do_return_node(xpl::return_node * const node, int lvl) {
+  line(node);
+  os() << indent() << (_procedure ? "return;" : "return " + result + ";") << std::endl;
+}
+
+void xpl::c_writer::do_stop_node(xpl::stop_node * const node, int lvl) {
+  if (_loops == 0) {
+    _compiler->error(node->lineno(), "Stop outside loop.");
+    return;
+  }
+  line(node);
+  os() << indent() << "break;" << std::endl;
+}
+
+//------------ BASIC NODES - DECLARATION -------------------------------------
+
+void xpl::c_writer::do_decl_variable_node(xpl::decl_variable_node * const node, int lvl) {
+  ASSERT_SAFE_EXPRESSIONS;
+
+  const std::string &id = *node->name();
+  auto symbol = std::make_shared<xpl::symbol>(node->toImport(), _infn, false, false, node->type(), id, 0);
+  _symtab.insert(id, symbol);
+
+  if (_argdcl) {    // a parameter
+    os() << declare(node->type(), name(id));
+    return;
+  }
+
+  if (!_infn && node->init() != nullptr && dynamic_cast<cdk::integer_node*>(node->init()) == nullptr &&
+      dynamic_cast<cdk::double_node*>(node->init()) == nullptr &&
+      dynamic_cast<cdk::string_node*>(node->init()) == nullptr) {
+    _compiler->error(node->lineno(), "A global variable can only be initialized with a literal");
+    return;
+  }
+
+  line(node);
+  os() << indent();
+  if (!_infn) os() << (node->toImport() ? "extern " : node->toExport() ? "" : "static ");
+  os() << declare(node->type(), name(id));
+  if (node->init() != nullptr && !node->toImport()) {
+    os() << " = ";
+    convert(node->init(), node->type(), lvl + 2);
+  }
+  os() << ";" << std::endl;
+}
+
+void xpl::c_writer::do_decl_function_node(xpl::decl_function_node * const node, int lvl) {
+  ASSERT_SAFE_EXPRESSIONS;
+
+  const std::string &id = *node->name();
+  auto symbol = std::make_shared<xpl::symbol>(node->toImport(), true, true, false, node->type(), id, 0);
+  for (size_t i = 0; i < node->argument()->size(); i++) {
+    auto decl = dynamic_cast<xpl::decl_variable_node*>(node->argument()->node(i));
+    if (decl != nullptr) symbol->addArg(*decl->type());
+  }
+  if (!_symtab.insert(id, symbol)) {
+    _compiler->error(node->lineno(), "Error inserting new function " + id + " symbol.");
+    return;
+  }
+
+  os() << (node->toImport() ? "extern " : _external.count(id) ? "" : "static ")
+       << declare(node->type(), id == "xpl" ? "_main" : name(id));
+  _symtab.push();   // the parameters' names are only the prototype's
+  parameters(node->argument(), lvl);
+  _symtab.pop();
+  os() << ";" << std::endl;
+}
+
+//------------ BASIC NODES - CONDITION ---------------------------------------
+
+void xpl::c_writer::do_if_node(xpl::if_node * const node, int lvl) {
+  ASSERT_SAFE_EXPRESSIONS;
+  line(node);
+  os() << indent() << "if (";
+  expression(node->condition(), lvl + 2);
+  os() << ") ";
+  body(node->block(), lvl);
+  os() << std::endl;
+}
+
+void xpl::c_writer::do_if_else_node(xpl::if_else_node * const node, int lvl) {
+  ASSERT_SAFE_EXPRESSIONS;
+  line(node);
+  os() << indent() << "if (";
+  expression(node->condition(), lvl + 2);
+  os() << ") ";
+  body(node->thenblock(), lvl);
+  os() << " else ";
+  body(node->elseblock(), lvl);
+  os() << std::endl;
+}
+
+//------------ BASIC NODES - ITERATION ---------------------------------------
+
+void xpl::c_writer::do_sweep_node(xpl::sweep_node * const node, int lvl) {
+  ASSERT_SAFE_EXPRESSIONS;
+  line(node);
+  os() << indent() << "for (";
+  node->lvalue()->accept(this, lvl + 2);
+  os() << " = ";
+  convert(node->init(), node->lvalue()->type(), lvl + 2);
+  os() << "; ";
+  node->lvalue()->accept(this, lvl + 2);
+  os() << (node->signal() ? " <= " : " >= ");
+  expression(node->condition(), lvl + 2);
+  os() << "; ";
+  node->lvalue()->accept(this, lvl + 2);
+  os() << (node->signal() ? " += " : " -= ");
+  if (node->add() != nullptr)
+    expression(node->add(), lvl + 2);
+  else
+    os() << "1";
+  os() << ") ";
+  _loops++;
+  body(node->block(), lvl);
+  _loops--;
+  os() << std::endl;
+}
+
+void xpl::c_writer::do_while_node(xpl::while_node * const node, int lvl) {
+  ASSERT_SAFE_EXPRESSIONS;
+  line(node);
+  os() << indent() << "while (";
+  expression(node->condition(), lvl + 2);
+  os() << ") ";
+  _loops++;
+  body(node->block(), lvl);
+  _loops--;
+  os() << std::endl;
+}
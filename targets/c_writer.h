@@ -0,0 +1,140 @@
+#ifndef __XPL_SEMANTICS_C_WRITER_H__
+#define __XPL_SEMANTICS_C_WRITER_H__
+
+#include <set>
+#include <string>
+#include <iostream>
+#include <cdk/symbol_table.h>
+#include "targets/basic_ast_visitor.h"
+#include "targets/symbol.h"
+
+namespace xpl {
+
+  //!
+  //! Translates the program to C (the "c" target), so that a C compiler
+  //! can build it against the same runtime: ints, reals, strings and
+  //! pointers are int, double, char* and T*, xpl is _main, functions and
+  //! variables neither public nor use are static, memory allocations are
+  //! allocas and prints and reads call the RTS. Like the native code, it
+  //! assumes pointers fit in an int (addresses, "x?", are ints), so the C
+  //! must be compiled for 32 bits (gcc -m32): elsewhere (LP64) it does not
+  //! compile, by a _Static_assert in its prelude.
+  //!
+  class c_writer: public basic_ast_visitor {
+    cdk::symbol_table<xpl::symbol> &_symtab;
+    std::set<std::string> _external; // functions with external linkage (see external_functions)
+    int _depth = 0;                  // of the statement being written (for indentation)
+    int _loops = 0;                  // enclosing loops (for next and stop)
+    bool _infn = false;
+    bool _procedure = false;         // the function being written returns nothing
+    bool _argdcl = false;            // declaring a function's arguments (a parameter list)
+
+  public:
+    c_writer(std::shared_ptr<cdk::compiler> compiler, cdk::symbol_table<xpl::symbol> &symtab) :
+        basic_ast_visitor(compiler), _symtab(symtab) {
+    }
+
+  public:
+    ~c_writer() {
+      os().flush();
+    }
+
+  private:
+    inline std::string indent() {
+      return std::string(2 * _depth, ' ');
+    }
+
+    // The C name of an XPL one: xpl is _main (as the RTS wants); names C
+    // reserves, or this writer uses, get an underscore.
+    std::string name(const std::string &id);
+
+    // The C type of an XPL type, and a declaration of name with it.
+    std::string ctype(basic_type *type);
+    std::string declare(basic_type *type, const std::string &name);
+
+    // Writes an expression (0 for a null one) converted to type: between
+    // ints and pointers (or strings), and between unrelated pointers, a cast.
+    void expression(cdk::expression_node * const node, int lvl);
+    void convert(cdk::expression_node * const node, basic_type *type, int lvl);
+
+    // Writes a binary operation, parenthesized (compare converts pointers to
+    // int when the operands' types differ).
+    void binary(cdk::binary_expression_node * const node, const char *op, int lvl);
+    void compare(cdk::binary_expression_node * const node, const char *op, int lvl);
+
+    // Writes a function's parameters, declaring them in the current scope.
+    void parameters(cdk::sequence_node * const args, int lvl);
+
+    // Writes a statement in braces (a block's declarations and instructions
+    // go straight in).
+    void body(cdk::basic_node * const node, int lvl);
+    void contents(xpl::block_node * const node, int lvl);
+
+    // With -g, the source line of what follows.
+    void line(cdk::basic_node * const node);
+
+  public:
+    void do_sequence_node(cdk::sequence_node * const node, int lvl);
+
+  public:
+    void do_integer_node(cdk::integer_node * const node, int lvl);
+    void do_double_node(cdk::double_node * const node, int lvl);
+    void do_string_node(cdk::string_node * const node, int lvl);
+
+  public:
+    void do_neg_node(cdk::neg_node * const node, int lvl);
+    void do_not_node(cdk::not_node * const node, int lvl);
+    void do_identity_node(xpl::identity_node * const node, int lvl);
+    void do_memalloc_node(xpl::memalloc_node * const node, int lvl);
+    void do_address_node(xpl::address_node * const node, int lvl);
+
+  public:
+    void do_add_node(cdk::add_node * const node, int lvl);
+    void do_sub_node(cdk::sub_node * const node, int lvl);
+    void do_mul_node(cdk::mul_node * const node, int lvl);
+    void do_div_node(cdk::div_node * const node, int lvl);
+    void do_mod_node(cdk::mod_node * const node, int lvl);
+    void do_lt_node(cdk::lt_node * const node, int lvl);
+    void do_le_node(cdk::le_node * const node, int lvl);
+    void do_ge_node(cdk::ge_node * const node, int lvl);
+    void do_gt_node(cdk::gt_node * const node, int lvl);
+    void do_ne_node(cdk::ne_node * const node, int lvl);
+    void do_eq_node(cdk::eq_node * const node, int lvl);
+    void do_and_node(cdk::and_node * const node, int lvl);
+    void do_or_node(cdk::or_node * const node, int lvl);
+
+  public:
+    void do_identifier_node(cdk::identifier_node * const node, int lvl);
+    void do_rvalue_node(cdk::rvalue_node * const node, int lvl);
+    void do_assignment_node(cdk::assignment_node * const node, int lvl);
+    void do_funcall_node(xpl::funcall_node * const node, int lvl);
+    void do_index_node(xpl::index_node * const node, int lvl);
+    void do_read_node(xpl::read_node * const node, int lvl);
+
+  public:
+    void do_body_node(xpl::body_node * const node, int lvl);
+    void do_block_node(xpl::block_node * const node, int lvl);
+    void do_evaluation_node(xpl::evaluation_node * const node, int lvl);
+    void do_function_node(xpl::function_node * const node, int lvl);
+    void do_next_node(xpl::next_node * const node, int lvl);
+    void do_print_node(xpl::print_node * const node, int lvl);
+    void do_return_node(xpl::return_node * const node, int lvl);
+    void do_stop_node(xpl::stop_node * const node, int lvl);
+
+  public:
+    void do_decl_variable_node(xpl::decl_variable_node * const node, int lvl);
+    void do_decl_function_node(xpl::decl_function_node * const node, int lvl);
+
+  public:
+    void do_if_node(xpl::if_node * const node, int lvl);
+    void do_if_else_node(xpl::if_else_node * const node, int lvl);
+
+  public:
+    void do_sweep_node(xpl::sweep_node * const node, int lvl);
+    void do_while_node(xpl::while_node * const node, int lvl);
+
+  };
+
+} // xpl
+
+#endif
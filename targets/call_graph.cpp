@@ -0,0 +1,58 @@
+#include <vector>
+#include "targets/call_graph.h"
+#include "targets/fingerprint.h"
+#include "ast/all.h"  // automatically generated
+
+//---------------------------------------------------------------------------
+
+xpl::call_graph::call_graph(std::shared_ptr<cdk::compiler> compiler,
+                            cdk::sequence_node * const program) {
+  for (size_t i = 0; i < program->size(); i++) {
+    cdk::basic_node *node = program->node(i);
+    std::string name;
+    bool exported = false;
+    if (auto fn = dynamic_cast<xpl::function_node*>(node)) {
+      name = *fn->name();
+      exported = fn->toExport();
+    } else if (auto decl = dynamic_cast<xpl::decl_function_node*>(node)) {
+      if (decl->toExport()) _roots.insert(*decl->name());
+      continue;
+    } else if (auto var = dynamic_cast<xpl::decl_variable_node*>(node)) {
+      if (var->toImport()) continue;
+      name = *var->name();
+      exported = var->toExport();
+    } else
+      continue;
+
+    xpl::fingerprint fp(compiler);
+    node->accept(&fp, 0);
+    _refs[name].insert(fp.names().begin(), fp.names().end());
+    if (exported || name == "xpl") _roots.insert(name);
+  }
+
+  std::vector<std::string> work(_roots.begin(), _roots.end());
+  while (!work.empty()) {
+    std::string next = work.back();
+    work.pop_back();
+    if (!_used.insert(next).second) continue;
+    auto refs = _refs.find(next);
+    if (refs != _refs.end()) work.insert(work.end(), refs->second.begin(), refs->second.end());
+  }
+}
+
+bool xpl::call_graph::used(const std::string &name) const {
+  return _used.count(name) > 0 || _refs.count(name) == 0;
+}
+
+std::set<std::string> xpl::external_functions(cdk::sequence_node * const program) {
+  std::set<std::string> names = { "xpl" };
+  for (size_t i = 0; i < program->size(); i++) {
+    cdk::basic_node *node = program->node(i);
+    if (auto fn = dynamic_cast<xpl::function_node*>(node)) {
+      if (fn->toExport() || fn->toImport()) names.insert(*fn->name());
+    } else if (auto decl = dynamic_cast<xpl::decl_function_node*>(node)) {
+      if (decl->toExport() || decl->toImport()) names.insert(*decl->name());
+    }
+  }
+  return names;
+}
@@ -0,0 +1,42 @@
+#ifndef __XPL_CALL_GRAPH_H__
+#define __XPL_CALL_GRAPH_H__
+
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <cdk/compiler.h>
+#include <cdk/ast/sequence_node.h>
+
+namespace xpl {
+
+  /**
+   * Which top-level definitions of a program are used: starting at xpl
+   * and at the public functions and variables, follows every name a
+   * definition refers to (calls, and also variables and functions whose
+   * address is taken). A local that hides a global only makes the global
+   * look used, so the answer errs on the side of keeping things.
+   */
+  class call_graph {
+    std::map<std::string, std::set<std::string>> _refs; // names used by each definition
+    std::set<std::string> _roots;
+    std::set<std::string> _used;
+
+  public:
+    call_graph(std::shared_ptr<cdk::compiler> compiler, cdk::sequence_node * const program);
+
+    /** @return whether the definition of name is needed (names not defined here always are) */
+    bool used(const std::string &name) const;
+  };
+
+  /**
+   * The functions at the boundary of the program, whose calling convention
+   * is fixed: xpl (called by the runtime) and those declared or defined
+   * public or use anywhere in it. The others are internal (see
+   * symbol::registers).
+   */
+  std::set<std::string> external_functions(cdk::sequence_node * const program);
+
+} // xpl
+
+#endif
@@ -0,0 +1,286 @@
+#include <string>
+#include <iomanip>
+#include "targets/fingerprint.h"
+#include "ast/all.h"  // automatically generated
+
+//---------------------------------------------------------------------------
+
+std::string xpl::fingerprint::text(basic_type *type) {
+  if (type == nullptr) return "-";
+  std::ostringstream oss;
+  oss << type->name() << ":" << type->size();
+  if (type->subtype() != nullptr)
+    oss << "<" << text(type->subtype()) << ">";
+  return oss.str();
+}
+
+void xpl::fingerprint::open(cdk::basic_node * const node) {
+  _text << "(" << node->label();
+  if (_lines && debug()) _text << "@" << node->lineno();
+}
+
+void xpl::fingerprint::close() {
+  _text << ")";
+}
+
+void xpl::fingerprint::child(cdk::basic_node * const node, int lvl) {
+  if (node == nullptr)
+    _text << " ~";
+  else {
+    _text << " ";
+    node->accept(this, lvl + 2);
+  }
+}
+
+void xpl::fingerprint::do_sequence_node(cdk::sequence_node * const node, int lvl) {
+  open(node);
+  for (size_t i = 0; i < node->size(); i++)
+    child(node->node(i), lvl);
+  close();
+}
+
+//------------ LITERALS -----------------------------------------------------
+
+void xpl::fingerprint::do_integer_node(cdk::integer_node * const node, int lvl) {
+  open(node);
+  _text << " " << node->value();
+  close();
+}
+
+void xpl::fingerprint::do_double_node(cdk::double_node * const node, int lvl) {
+  open(node);
+  _text << " " << std::setprecision(17) << node->value();
+  close();
+}
+
+void xpl::fingerprint::do_string_node(cdk::string_node * const node, int lvl) {
+  open(node);
+  _text << " " << node->value().size() << ":" << node->value();
+  close();
+}
+
+//------------ UNARY EXPRESSIONS --------------------------------------------
+
+void xpl::fingerprint::do_unary_expression(cdk::unary_expression_node * const node, int lvl) {
+  open(node);
+  child(node->argument(), lvl);
+  close();
+}
+
+void xpl::fingerprint::do_neg_node(cdk::neg_node * const node, int lvl) {
+  do_unary_expression(node, lvl);
+}
+void xpl::fingerprint::do_not_node(cdk::not_node * const node, int lvl) {
+  do_unary_expression(node, lvl);
+}
+void xpl::fingerprint::do_identity_node(xpl::identity_node * const node, int lvl) {
+  do_unary_expression(node, lvl);
+}
+void xpl::fingerprint::do_memalloc_node(xpl::memalloc_node * const node, int lvl) {
+  do_unary_expression(node, lvl);
+}
+void xpl::fingerprint::do_address_node(xpl::address_node * const node, int lvl) {
+  auto id = dynamic_cast<cdk::identifier_node*>(node->argument());
+  if (id != nullptr) _addressed.insert(id->name());
+  do_unary_expression(node, lvl);
+}
+
+//------------ BINARY EXPRESSIONS -------------------------------------------
+
+void xpl::fingerprint::do_binary_expression(cdk::binary_expression_node * const node, int lvl) {
+  open(node);
+  child(node->left(), lvl);
+  child(node->right(), lvl);
+  close();
+}
+
+void xpl::fingerprint::do_add_node(cdk::add_node * const node, int lvl) {
+  do_binary_expression(node, lvl);
+}
+void xpl::fingerprint::do_sub_node(cdk::sub_node * const node, int lvl) {
+  do_binary_expression(node, lvl);
+}
+void xpl::fingerprint::do_mul_node(cdk::mul_node * const node, int lvl) {
+  do_binary_expression(node, lvl);
+}
+void xpl::fingerprint::do_div_node(cdk::div_node * const node, int lvl) {
+  do_binary_expression(node, lvl);
+}
+void xpl::fingerprint::do_mod_node(cdk::mod_node * const node, int lvl) {
+  do_binary_expression(node, lvl);
+}
+void xpl::fingerprint::do_lt_node(cdk::lt_node * const node, int lvl) {
+  do_binary_expression(node, lvl);
+}
+void xpl::fingerprint::do_le_node(cdk::le_node * const node, int lvl) {
+  do_binary_expression(node, lvl);
+}
+void xpl::fingerprint::do_ge_node(cdk::ge_node * const node, int lvl) {
+  do_binary_expression(node, lvl);
+}
+void xpl::fingerprint::do_gt_node(cdk::gt_node * const node, int lvl) {
+  do_binary_expression(node, lvl);
+}
+void xpl::fingerprint::do_ne_node(cdk::ne_node * const node, int lvl) {
+  do_binary_expression(node, lvl);
+}
+void xpl::fingerprint::do_eq_node(cdk::eq_node * const node, int lvl) {
+  do_binary_expression(node, lvl);
+}
+void xpl::fingerprint::do_and_node(cdk::and_node * const node, int lvl) {
+  do_binary_expression(node, lvl);
+}
+void xpl::fingerprint::do_or_node(cdk::or_node * const node, int lvl) {
+  do_binary_expression(node, lvl);
+}
+
+//------------ EXPRESSIONS --------------------------------------------------
+
+void xpl::fingerprint::do_identifier_node(cdk::identifier_node * const node, int lvl) {
+  open(node);
+  _text << " " << node->name();
+  _names.insert(node->name());
+  close();
+}
+
+void xpl::fingerprint::do_rvalue_node(cdk::rvalue_node * const node, int lvl) {
+  open(node);
+  child(node->lvalue(), lvl);
+  close();
+}
+
+void xpl::fingerprint::do_assignment_node(cdk::assignment_node * const node, int lvl) {
+  open(node);
+  child(node->lvalue(), lvl);
+  child(node->rvalue(), lvl);
+  close();
+}
+
+void xpl::fingerprint::do_funcall_node(xpl::funcall_node * const node, int lvl) {
+  open(node);
+  _text << " " << *node->name();
+  _names.insert(*node->name());
+  child(node->argument(), lvl);
+  close();
+}
+
+void xpl::fingerprint::do_index_node(xpl::index_node * const node, int lvl) {
+  open(node);
+  child(node->expression(), lvl);
+  child(node->shift(), lvl);
+  close();
+}
+
+void xpl::fingerprint::do_read_node(xpl::read_node * const node, int lvl) {
+  open(node);
+  close();
+}
+
+//------------ BASIC NODES --------------------------------------------------
+
+void xpl::fingerprint::do_body_node(xpl::body_node * const node, int lvl) {
+  open(node);
+  child(node->declarations(), lvl);
+  child(node->instructions(), lvl);
+  close();
+}
+
+void xpl::fingerprint::do_block_node(xpl::block_node * const node, int lvl) {
+  open(node);
+  child(node->declarations(), lvl);
+  child(node->instructions(), lvl);
+  close();
+}
+
+void xpl::fingerprint::do_evaluation_node(xpl::evaluation_node * const node, int lvl) {
+  open(node);
+  child(node->argument(), lvl);
+  close();
+}
+
+void xpl::fingerprint::do_function_node(xpl::function_node * const node, int lvl) {
+  open(node);
+  _text << " " << *node->name() << " " << text(node->type()) << " " << node->toImport()
+        << node->toExport();
+  child(node->argument(), lvl);
+  child(node->literal(), lvl);
+  child(node->body(), lvl);
+  close();
+}
+
+void xpl::fingerprint::do_next_node(xpl::next_node * const node, int lvl) {
+  open(node);
+  close();
+}
+
+void xpl::fingerprint::do_print_node(xpl::print_node * const node, int lvl) {
+  open(node);
+  _text << " " << node->newline();
+  child(node->argument(), lvl);
+  close();
+}
+
+void xpl::fingerprint::do_return_node(xpl::return_node * const node, int lvl) {
+  open(node);
+  close();
+}
+
+void xpl::fingerprint::do_stop_node(xpl::stop_node * const node, int lvl) {
+  open(node);
+  close();
+}
+
+//------------ BASIC NODES - DECLARATION ------------------------------------
+
+void xpl::fingerprint::do_decl_variable_node(xpl::decl_variable_node * const node, int lvl) {
+  open(node);
+  _text << " " << *node->name() << " " << text(node->type()) << " " << node->toImport()
+        << node->toExport();
+  child(node->init(), lvl);
+  close();
+}
+
+void xpl::fingerprint::do_decl_function_node(xpl::decl_function_node * const node, int lvl) {
+  open(node);
+  _text << " " << *node->name() << " " << text(node->type()) << " " << node->toImport()
+        << node->toExport();
+  child(node->argument(), lvl);
+  close();
+}
+
+//------------ BASIC NODES - CONDITION --------------------------------------
+
+void xpl::fingerprint::do_if_node(xpl::if_node * const node, int lvl) {
+  open(node);
+  child(node->condition(), lvl);
+  child(node->block(), lvl);
+  close();
+}
+
+void xpl::fingerprint::do_if_else_node(xpl::if_else_node * const node, int lvl) {
+  open(node);
+  child(node->condition(), lvl);
+  child(node->thenblock(), lvl);
+  child(node->elseblock(), lvl);
+  close();
+}
+
+//------------ BASIC NODES - ITERATION --------------------------------------
+
+void xpl::fingerprint::do_sweep_node(xpl::sweep_node * const node, int lvl) {
+  open(node);
+  _text << " " << node->signal();
+  child(node->lvalue(), lvl);
+  child(node->init(), lvl);
+  child(node->condition(), lvl);
+  child(node->add(), lvl);
+  child(node->block(), lvl);
+  close();
+}
+
+void xpl::fingerprint::do_while_node(xpl::while_node * const node, int lvl) {
+  open(node);
+  child(node->condition(), lvl);
+  child(node->block(), lvl);
+  close();
+}
@@ -0,0 +1,364 @@
+#include <algorithm>
+#include <iomanip>
+#include <map>
+#include <set>
+#include <sstream>
+#include "targets/ir.h"
+
+//---------------------------------------------------------------------------
+
+const char *xpl::ir::name(type t) {
+  switch (t) {
+    case type::VOID:    return "void";
+    case type::INT:     return "int";
+    case type::REAL:    return "real";
+    case type::STRING:  return "string";
+    case type::POINTER: return "pointer";
+  }
+  return "?";
+}
+
+const char *xpl::ir::name(op code) {
+  static const char *names[] = {
+    "iconst", "dconst", "sconst", "undef", "arg", "global", "slot",
+    "add", "sub", "mul", "div", "mod", "neg", "not", "i2d",
+    "shl", "sar", "shr", "mulhi",
+    "lt", "le", "gt", "ge", "eq", "ne",
+    "load", "store", "alloc",
+    "call",
+    "phi",
+    "jmp", "br", "switch", "ret"
+  };
+  return names[(int)code];
+}
+
+void xpl::ir::instruction::replace_uses(instruction *other) {
+  for (auto user : users) {
+    if (user == other) continue;
+    for (auto &operand : user->operands)
+      if (operand == this) {
+        operand = other;
+        other->users.push_back(user);
+      }
+  }
+  users.clear();
+}
+
+bool xpl::ir::instruction::constant(long &value) const {
+  long a, b;
+  if (ty != type::INT) return false;
+  if (code == op::ICONST) {
+    value = ival;
+    return true;
+  }
+  if (code == op::NEG && operands[0]->constant(a)) {
+    value = (int)(unsigned)-a;
+    return true;
+  }
+  if ((code == op::ADD || code == op::SUB || code == op::MUL) && operands[0]->constant(a) && operands[1]->constant(b)) {
+    unsigned x = a, y = b;   // wrapping around like the machine does
+    value = (int)(code == op::ADD ? x + y : code == op::SUB ? x - y : x * y);
+    return true;
+  }
+  return false;
+}
+
+void xpl::ir::function::remove(instruction *i) {
+  auto &code = i->parent->code;
+  code.erase(std::remove(code.begin(), code.end(), i), code.end());
+  for (auto operand : i->operands) {
+    auto &users = operand->users;
+    users.erase(std::remove(users.begin(), users.end(), i), users.end());
+  }
+  i->parent = nullptr;
+}
+
+void xpl::ir::function::disconnect(block *from, block *to) {
+  to->preds.erase(std::remove(to->preds.begin(), to->preds.end(), from), to->preds.end());
+  for (auto phi : to->code) {
+    if (phi->code != op::PHI) break;
+    for (size_t k = phi->targets.size(); k-- > 0;) {
+      if (phi->targets[k] != from) continue;
+      auto &users = phi->operands[k]->users;
+      users.erase(std::find(users.begin(), users.end(), phi));
+      phi->operands.erase(phi->operands.begin() + k);
+      phi->targets.erase(phi->targets.begin() + k);
+    }
+  }
+}
+
+std::vector<bool> xpl::ir::function::reachable() const {
+  std::vector<bool> seen(blocks.size(), false);
+  std::vector<const block*> work;
+  if (!blocks.empty()) work.push_back(blocks[0].get());
+  while (!work.empty()) {
+    const block *b = work.back();
+    work.pop_back();
+    if (seen[b->id]) continue;
+    seen[b->id] = true;
+    for (auto s : b->succs())
+      work.push_back(s);
+  }
+  return seen;
+}
+
+void xpl::ir::function::prune() {
+  std::vector<bool> live = reachable();
+  for (auto &b : blocks) {
+    if (live[b->id]) continue;
+    for (auto s : b->succs()) {
+      if (live[s->id]) disconnect(b.get(), s);
+    }
+    std::vector<instruction*> code = b->code;
+    for (auto i : code)
+      remove(i);
+  }
+  blocks.erase(std::remove_if(blocks.begin(), blocks.end(),
+                              [&live](const std::unique_ptr<block> &b) { return !live[b->id]; }),
+               blocks.end());
+  for (size_t k = 0; k < blocks.size(); k++)
+    blocks[k]->id = k;
+}
+
+void xpl::ir::function::straighten() {
+  prune();   // unreachable predecessors would count
+  for (auto &b : blocks) {
+    for (instruction *t = b->terminator(); t != nullptr && t->code == op::JMP; t = b->terminator()) {
+      block *s = t->targets[0];
+      if (s == b.get() || s == blocks[0].get() || s->preds.size() != 1) break;
+      std::vector<instruction*> code = s->code;
+      for (auto i : code)
+        if (i->code == op::PHI) {   // a single value
+          i->replace_uses(i->operands[0]);
+          remove(i);
+        }
+      remove(t);
+      for (auto i : s->code) {
+        i->parent = b.get();
+        b->code.push_back(i);
+      }
+      s->code.clear();
+      s->preds.clear();
+      for (auto next : b->succs()) {
+        std::replace(next->preds.begin(), next->preds.end(), s, b.get());
+        for (auto phi : next->code) {
+          if (phi->code != op::PHI) break;
+          std::replace(phi->targets.begin(), phi->targets.end(), s, b.get());
+        }
+      }
+    }
+  }
+  prune();
+}
+
+std::vector<std::set<size_t>> xpl::ir::function::dominators() const {
+  // iterative (blocks are few); unreachable predecessors are ignored
+  std::vector<bool> reachable = this->reachable();
+  size_t n = blocks.size();
+  std::vector<std::set<size_t>> dom(n);
+  std::set<size_t> all;
+  for (size_t k = 0; k < n; k++) all.insert(k);
+  for (size_t k = 0; k < n; k++) dom[k] = k == 0 ? std::set<size_t> { 0 } : all;
+  for (bool changed = true; changed;) {
+    changed = false;
+    for (size_t k = 1; k < n; k++) {
+      std::set<size_t> d = all;
+      for (auto p : blocks[k]->preds) {
+        if (!reachable[p->id]) continue;
+        std::set<size_t> meet;
+        std::set_intersection(d.begin(), d.end(), dom[p->id].begin(), dom[p->id].end(),
+                              std::inserter(meet, meet.begin()));
+        d = meet;
+      }
+      d.insert(k);
+      if (d != dom[k]) {
+        dom[k] = d;
+        changed = true;
+      }
+    }
+  }
+  return dom;
+}
+
+//---------------------------------------------------------------------------
+//     PRINTER
+//---------------------------------------------------------------------------
+
+static std::string quoted(const std::string &s) {
+  std::ostringstream oss;
+  oss << '"';
+  for (unsigned char c : s) {
+    if (c == '"' || c == '\\') oss << '\\' << c;
+    else if (c < 32 || c > 126) oss << "\\" << std::hex << std::setw(2) << std::setfill('0') << (int)c << std::dec;
+    else oss << c;
+  }
+  oss << '"';
+  return oss.str();
+}
+
+void xpl::ir::function::print(std::ostream &os) const {
+  os << "function " << name << " : " << ir::name(ret) << (exported ? " public" : "") << " {" << std::endl;
+  for (auto &b : blocks) {
+    os << "b" << b->id << ":";
+    if (!b->preds.empty()) {
+      os << "\t\t\t; preds";
+      for (auto p : b->preds) os << " b" << p->id;
+    }
+    os << std::endl;
+    for (auto i : b->code) {
+      os << "\t";
+      if (i->has_value()) os << "%" << i->id << " = ";
+      os << ir::name(i->code);
+      if (i->has_value()) os << " " << ir::name(i->ty);
+      switch (i->code) {
+        case op::ICONST: case op::ARG: os << " " << i->ival; break;
+        case op::DCONST: os << " " << std::setprecision(17) << i->dval; break;
+        case op::SCONST: os << " " << quoted(i->sval); break;
+        case op::GLOBAL: case op::CALL: os << " " << i->sval; break;
+        case op::SLOT: if (i->ival > 0) os << " " << i->ival; break;
+        default: break;
+      }
+      for (size_t k = 0; k < i->operands.size(); k++) {
+        os << (k == 0 && i->code != op::GLOBAL && i->code != op::CALL ? " " : ", ");
+        if (i->code == op::PHI) os << "[";
+        os << "%" << i->operands[k]->id;
+        if (i->code == op::PHI) os << ", b" << i->targets[k]->id << "]";
+      }
+      if (i->code != op::PHI)
+        for (size_t k = 0; k < i->targets.size(); k++)
+          os << (k == 0 && i->operands.empty() ? " " : ", ") << "b" << i->targets[k]->id;
+      os << std::endl;
+    }
+  }
+  os << "}" << std::endl;
+}
+
+//---------------------------------------------------------------------------
+//     VERIFIER
+//---------------------------------------------------------------------------
+
+void xpl::ir::function::verify() const {
+  auto fail = [this](const std::string &what, const instruction *i) {
+    std::ostringstream oss;
+    oss << "IR of " << name << ": " << what;
+    if (i != nullptr) oss << " (%" << i->id << " " << ir::name(i->code) << " in b" << i->parent->id << ")";
+    throw oss.str();
+  };
+
+  if (blocks.empty()) fail("no entry block", nullptr);
+  if (!blocks[0]->preds.empty()) fail("entry block has predecessors", nullptr);
+
+  // only code reachable from the entry is checked (and emitted)
+  std::vector<bool> reachable = this->reachable();
+
+  // structure: one terminator per block, at the end; phis first; consistent predecessors
+  std::map<const block*, size_t> index;
+  for (auto &b : blocks) {
+    if ((size_t)b->id != index.size()) fail("block b" + std::to_string(b->id) + " out of place", nullptr);
+    index[b.get()] = b->id;
+  }
+  for (auto &b : blocks) {
+    if (!reachable[b->id]) continue;
+    if (b->terminator() == nullptr) fail("block b" + std::to_string(b->id) + " has no terminator", nullptr);
+    bool phis = true;
+    for (size_t k = 0; k < b->code.size(); k++) {
+      instruction *i = b->code[k];
+      if (i->parent != b.get()) fail("instruction in the wrong block", i);
+      if (i->terminator() && k + 1 != b->code.size()) fail("terminator in the middle of a block", i);
+      if (i->code == op::PHI && !phis) fail("phi after a non-phi", i);
+      if (i->code != op::PHI) phis = false;
+      for (auto t : i->targets)
+        if (index.count(t) == 0) fail("branch to a foreign block", i);
+    }
+    for (auto s : b->succs())
+      if (std::count(s->preds.begin(), s->preds.end(), b.get()) == 0)
+        fail("b" + std::to_string(b->id) + " is not a predecessor of its successor b" + std::to_string(s->id), nullptr);
+    for (auto p : b->preds) {
+      auto succs = p->succs();
+      if (std::count(succs.begin(), succs.end(), b.get()) == 0)
+        fail("b" + std::to_string(p->id) + " listed as predecessor of b" + std::to_string(b->id), nullptr);
+    }
+  }
+
+  std::vector<std::set<size_t>> dom = dominators();
+
+  // operands: defined in the function, typed, and dominating their uses
+  std::map<const instruction*, size_t> position;
+  for (auto &b : blocks)
+    for (size_t k = 0; k < b->code.size(); k++) position[b->code[k]] = k;
+  for (auto &b : blocks) {
+    if (!reachable[index[b.get()]]) continue;
+    for (auto i : b->code) {
+      if (i->code == op::PHI && i->operands.size() != b->preds.size()) fail("phi arity differs from predecessors", i);
+      for (size_t k = 0; k < i->operands.size(); k++) {
+        instruction *v = i->operands[k];
+        if (position.count(v) == 0) fail("operand %" + std::to_string(v->id) + " is not in the function", i);
+        if (!v->has_value()) fail("operand %" + std::to_string(v->id) + " has no value", i);
+        const block *use = i->code == op::PHI ? i->targets[k] : b.get();
+        size_t du = index[use], dv = index[v->parent];
+        if (!reachable[du]) continue;   // phi operand from an unreachable predecessor
+        bool dominated = dv == du ? (i->code == op::PHI || position[v] < position[i]) : dom[du].count(dv) > 0;
+        if (!dominated) fail("operand %" + std::to_string(v->id) + " does not dominate its use", i);
+      }
+      switch (i->code) {
+        case op::ADD: case op::SUB: case op::MUL: case op::DIV: case op::NEG:
+          for (auto v : i->operands)
+            if (v->ty != i->ty && !(i->ty == type::POINTER || i->ty == type::STRING || v->ty == type::POINTER))
+              fail("operand type differs from result type", i);
+          break;
+        case op::MOD: case op::NOT: case op::SHL: case op::SAR: case op::SHR: case op::MULHI:
+          if (i->ty != type::INT) fail("integer operation with non-integer result", i);
+          break;
+        case op::LT: case op::LE: case op::GT: case op::GE: case op::EQ: case op::NE:
+          if (i->ty != type::INT || i->operands.size() != 2) fail("malformed comparison", i);
+          if ((i->operands[0]->ty == type::REAL) != (i->operands[1]->ty == type::REAL))
+            fail("comparison of real with non-real", i);
+          break;
+        case op::I2D:
+          if (i->ty != type::REAL || i->operands[0]->ty != type::INT) fail("malformed conversion", i);
+          break;
+        case op::STORE:
+          if (i->operands.size() != 2) fail("malformed store", i);
+          break;
+        case op::PHI:
+          for (auto v : i->operands)   // int, string and pointer words are interchangeable
+            if (size(v->ty) != size(i->ty)) fail("phi operand of a different size", i);
+          break;
+        case op::BR:
+          if (i->operands.size() != 1 || i->targets.size() != 2) fail("malformed branch", i);
+          break;
+        case op::JMP:
+          if (i->targets.size() != 1) fail("malformed jump", i);
+          break;
+        case op::SWITCH: {
+          long value;
+          if (i->operands.size() < 2 || i->operands.size() != i->targets.size()) fail("malformed switch", i);
+          if (i->operands[0]->ty != type::INT) fail("switch on a non-int value", i);
+          for (size_t k = 1; k < i->operands.size(); k++)
+            if (!i->operands[k]->constant(value)) fail("switch case is not a constant", i);
+          break;
+        }
+        case op::RET:
+          if ((ret == type::VOID) != i->operands.empty()) fail("return value does not match the function", i);
+          if (!i->operands.empty() && i->operands[0]->ty != ret) fail("return value of the wrong type", i);
+          break;
+        default:
+          break;
+      }
+    }
+  }
+}
+
+std::vector<long> xpl::ir::places(const instruction *call) {
+  std::vector<long> result;
+  long offset = 8;  // pushed last to first, so the first one on the stack is at 8
+  for (size_t k = 0; k < call->operands.size(); k++) {
+    if ((long)k < call->ival) {
+      result.push_back(-(long)k - 1);
+    } else {
+      result.push_back(offset);
+      offset += size(call->operands[k]->ty);
+    }
+  }
+  return result;
+}
@@ -0,0 +1,190 @@
+#ifndef __XPL_IR_H__
+#define __XPL_IR_H__
+
+#include <algorithm>
+#include <iostream>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace xpl {
+  namespace ir {
+
+    //!
+    //! SSA intermediate representation of function bodies. A function is a
+    //! list of basic blocks; a block is a list of instructions ending in a
+    //! terminator (jmp, br, switch, ret). Every instruction is also the value it
+    //! computes (%n). Locals whose address is never taken are SSA values
+    //! (joined by phi instructions); everything else lives in memory and is
+    //! accessed with load/store through slot/global/pointer addresses.
+    //!
+
+    enum class type {
+      VOID, INT, REAL, STRING, POINTER
+    };
+
+    enum class op {
+      // constants and addresses
+      ICONST,     // int constant (ival)
+      DCONST,     // real constant (dval)
+      SCONST,     // address of a string literal (sval)
+      UNDEF,      // value of an uninitialized variable
+      ARG,        // value of the argument at frame offset ival (ival < 0: passed in argument register -ival - 1)
+      GLOBAL,     // address of the global sval
+      SLOT,       // address of an argument (at offset ival > 0) or of a local slot (ival 0: placed by the lowering)
+      // arithmetic and logic (operands of the instruction's type, except comparisons)
+      ADD, SUB, MUL, DIV, MOD, NEG, NOT, I2D,
+      SHL,        // shl(value, bits): int shift to the left
+      SAR, SHR,   // sar/shr(value, bits): int shift to the right (signed/unsigned)
+      MULHI,      // mulhi(a, b): high word of the 64 bit product
+      LT, LE, GT, GE, EQ, NE,
+      // memory
+      LOAD,       // load(address)
+      STORE,      // store(address, value)
+      ALLOC,      // alloc(bytes): stack allocation, yields its address
+      // calls: function sval, arguments are the operands (the first ival of them go in argument registers)
+      CALL,
+      // SSA
+      PHI,        // operands[i] comes from targets[i]
+      // terminators
+      JMP,        // jmp targets[0]
+      BR,         // br operands[0], targets[0] (true), targets[1] (false)
+      SWITCH,     // switch operands[0], targets[0] (no case matches); case operands[k] (int constants) go to targets[k]
+      RET         // ret [operands[0]]
+    };
+
+    struct block;
+
+    struct instruction {
+      int id;
+      op code;
+      type ty;
+      block *parent;
+      std::vector<instruction*> operands;
+      std::vector<block*> targets;
+      std::vector<instruction*> users;
+      long ival = 0;
+      double dval = 0;
+      std::string sval;
+      int line = 0;           // of the statement it comes from (0: unknown, e.g. made by a pass)
+
+      instruction(int id, op code, type ty, block *parent) :
+          id(id), code(code), ty(ty), parent(parent) {
+      }
+
+      void add(instruction *operand) {
+        operands.push_back(operand);
+        operand->users.push_back(this);
+      }
+      bool terminator() const {
+        return code == op::JMP || code == op::BR || code == op::SWITCH || code == op::RET;
+      }
+      bool has_value() const {
+        return ty != type::VOID;
+      }
+      /** Replaces every use of this value by another (used when removing trivial phis). */
+      void replace_uses(instruction *other);
+      /** @return whether this is an int constant, also when folded from constants (-4 is neg 4) */
+      bool constant(long &value) const;
+    };
+
+    struct block {
+      int id;
+      std::vector<instruction*> code;
+      std::vector<block*> preds;
+      int heat = 0;           // from the profile: -1 never ran, 1 heads a hot loop
+
+      block(int id) :
+          id(id) {
+      }
+      instruction *terminator() const {
+        return code.empty() || !code.back()->terminator() ? nullptr : code.back();
+      }
+      std::vector<block*> succs() const {
+        instruction *t = terminator();
+        return t == nullptr ? std::vector<block*>() : t->targets;
+      }
+    };
+
+    struct function {
+      std::string name;       // assembly name (e.g. "_main" for "xpl")
+      type ret = type::VOID;
+      std::vector<type> params; // the arguments' types (see ARG)
+      long registers = 0;       // ... the first ones of which come in registers
+      bool exported = false;
+      bool profiled = false;  // block heats come from a profile
+      std::string source;     // with -g, the source file (the code is mapped to its lines)
+      int line = 0;           // ... and the function's line
+      std::vector<std::unique_ptr<block>> blocks;             // blocks[0] is the entry
+      std::vector<std::unique_ptr<instruction>> instructions; // owns every instruction
+
+      block *make_block() {
+        blocks.emplace_back(new block(blocks.size()));
+        return blocks.back().get();
+      }
+
+      /** Creates an instruction; it is appended to the block unless it is a phi. */
+      instruction *make(block *b, op code, type ty) {
+        instructions.emplace_back(new instruction(instructions.size(), code, ty, b));
+        instruction *i = instructions.back().get();
+        if (code == op::PHI)
+          b->code.insert(b->code.begin(), i);
+        else
+          b->code.push_back(i);
+        return i;
+      }
+
+      /** Creates an instruction (not a phi) just before another one, in the same block. */
+      instruction *insert(instruction *before, op code, type ty) {
+        block *b = before->parent;
+        instruction *i = make(b, code, ty);
+        i->line = before->line;
+        b->code.pop_back();
+        b->code.insert(std::find(b->code.begin(), b->code.end(), before), i);
+        return i;
+      }
+
+      /** Removes an instruction from its block (it stays owned by the function, with no parent). */
+      void remove(instruction *i);
+
+      /** Removes the edge from -> to from to's predecessors and phis (from's terminator is left as is). */
+      void disconnect(block *from, block *to);
+
+      /** @return for each block (by id), whether it is reachable from the entry */
+      std::vector<bool> reachable() const;
+
+      /** @return for each block (by id), the ids of the blocks that dominate it (itself included) */
+      std::vector<std::set<size_t>> dominators() const;
+
+      /** Removes the blocks that are not reachable from the entry (and renumbers the others). */
+      void prune();
+
+      /** Joins each block to the one that jumps to it, when that is its only predecessor (pruning before and after). */
+      void straighten();
+
+      /** Prints the function in a readable, assembly-like syntax. */
+      void print(std::ostream &os) const;
+
+      /** Checks structural and SSA invariants; throws std::string describing the first problem. */
+      void verify() const;
+    };
+
+    const char *name(type t);
+    const char *name(op code);
+    inline int size(type t) {
+      return t == type::REAL ? 8 : t == type::VOID ? 0 : 4;
+    }
+    /** Chains of at least this many int cases become switches (also in postfix_writer). */
+    const size_t SWITCH_CASES = 4;
+    /** @return whether cases from low to high are dense enough for a jump table (else: a binary search) */
+    inline bool dense(long long low, long long high, size_t cases) {
+      return high - low + 1 <= 3 * (long long)cases;
+    }
+    /** @return for each operand of a call, the ival of the callee's ARG that receives it */
+    std::vector<long> places(const instruction *call);
+
+  } // ir
+} // xpl
+
+#endif
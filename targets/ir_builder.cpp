@@ -0,0 +1,927 @@
+#include <string>
+#include "targets/ir_builder.h"
+#include "targets/type_checker.h"
+#include "targets/switch_chain.h"
+#include "targets/fingerprint.h"
+#include "targets/call_graph.h"
+#include "ast/all.h"  // all.h is automatically generated
+
+//---------------------------------------------------------------------------
+//     SSA CONSTRUCTION
+//---------------------------------------------------------------------------
+
+void xpl::ir_builder::write(int var, ir::block *b, ir::instruction *value) {
+  _defs[b][var] = value;
+}
+
+xpl::ir::instruction *xpl::ir_builder::read(int var, ir::block *b) {
+  auto &defs = _defs[b];
+  auto it = defs.find(var);
+  if (it != defs.end()) return it->second;
+  return read_recursive(var, b);
+}
+
+xpl::ir::instruction *xpl::ir_builder::read_recursive(int var, ir::block *b) {
+  ir::instruction *value;
+  if (_sealed.count(b) == 0) {          // operands are only known when the block is sealed
+    value = _fn->make(b, ir::op::PHI, _vartypes[var]);
+    _incomplete[b][var] = value;
+  } else if (b->preds.size() == 1) {    // no phi needed
+    value = read(var, b->preds[0]);
+  } else if (b->preds.empty()) {        // entry (or unreachable) block: never assigned
+    value = undef(_vartypes[var]);
+  } else {                              // break cycles with an operandless phi
+    value = _fn->make(b, ir::op::PHI, _vartypes[var]);
+    write(var, b, value);
+    value = add_phi_operands(var, value);
+  }
+  write(var, b, value);
+  return value;
+}
+
+xpl::ir::instruction *xpl::ir_builder::add_phi_operands(int var, ir::instruction *phi) {
+  for (auto pred : phi->parent->preds) {
+    phi->add(read(var, pred));
+    phi->targets.push_back(pred);
+  }
+  return try_remove_trivial_phi(phi);
+}
+
+xpl::ir::instruction *xpl::ir_builder::try_remove_trivial_phi(ir::instruction *phi) {
+  ir::instruction *same = nullptr;
+  for (auto operand : phi->operands) {
+    if (operand == same || operand == phi) continue;
+    if (same != nullptr) return phi;    // merges at least two values: not trivial
+    same = operand;
+  }
+  if (same == nullptr) same = undef(phi->ty); // unreachable or in the entry block
+
+  std::vector<ir::instruction*> users;
+  for (auto user : phi->users)
+    if (user != phi) users.push_back(user);
+  phi->replace_uses(same);
+  _fn->remove(phi);
+  for (auto &defs : _defs)
+    for (auto &def : defs.second)
+      if (def.second == phi) def.second = same;
+
+  // removing this phi may make others trivial
+  for (auto user : users)
+    if (user->code == ir::op::PHI && user->parent != nullptr)
+      try_remove_trivial_phi(user);
+  return same;
+}
+
+void xpl::ir_builder::seal(ir::block *b) {
+  if (_sealed.count(b)) return;
+  _sealed.insert(b);
+  auto incomplete = _incomplete[b];
+  _incomplete.erase(b);
+  for (auto &phi : incomplete)
+    add_phi_operands(phi.first, phi.second);
+}
+
+//---------------------------------------------------------------------------
+//     HELPERS
+//---------------------------------------------------------------------------
+
+xpl::ir::type xpl::ir_builder::convert(basic_type *type) {
+  if (type == nullptr) return ir::type::VOID;
+  switch (type->name()) {
+    case basic_type::TYPE_INT:     return ir::type::INT;
+    case basic_type::TYPE_DOUBLE:  return ir::type::REAL;
+    case basic_type::TYPE_STRING:  return ir::type::STRING;
+    case basic_type::TYPE_POINTER: return ir::type::POINTER;
+    default:                       return ir::type::VOID;
+  }
+}
+
+xpl::ir::instruction *xpl::ir_builder::make(ir::op code, ir::type ty) {
+  ir::instruction *i = _fn->make(_current, code, ty);
+  i->line = _line;
+  return i;
+}
+
+// Operands are computed before the instruction (the order the lowering relies on).
+xpl::ir::instruction *xpl::ir_builder::make(ir::op code, ir::type ty,
+                                            std::initializer_list<ir::instruction*> operands) {
+  ir::instruction *i = make(code, ty);
+  for (auto operand : operands)
+    i->add(operand);
+  return i;
+}
+
+// Instructions that must dominate every use (slots, undefined values) go to the entry block.
+xpl::ir::instruction *xpl::ir_builder::entry(ir::op code, ir::type ty) {
+  ir::block *b = _fn->blocks[0].get();
+  ir::instruction *i = _fn->make(b, code, ty);
+  b->code.pop_back();
+  b->code.insert(b->code.begin(), i);
+  return i;
+}
+
+xpl::ir::instruction *xpl::ir_builder::undef(ir::type ty) {
+  auto &value = _undefs[ty];
+  if (value == nullptr) value = entry(ir::op::UNDEF, ty);
+  return value;
+}
+
+xpl::ir::instruction *xpl::ir_builder::constant(int value) {
+  ir::instruction *i = make(ir::op::ICONST, ir::type::INT);
+  i->ival = value;
+  return i;
+}
+
+xpl::ir::instruction *xpl::ir_builder::to_real(ir::instruction *value) {
+  if (value->ty == ir::type::REAL) return value;
+  if (value->code == ir::op::ICONST) {
+    ir::instruction *i = make(ir::op::DCONST, ir::type::REAL);
+    i->dval = value->ival;
+    return i;
+  }
+  ir::instruction *i = make(ir::op::I2D, ir::type::REAL, { value });
+  return i;
+}
+
+// The only implicit conversion in XPL: integers where reals are expected.
+xpl::ir::instruction *xpl::ir_builder::as(ir::instruction *value, ir::type ty) {
+  return ty == ir::type::REAL ? to_real(value) : value;
+}
+
+xpl::ir::instruction *xpl::ir_builder::evaluate(cdk::expression_node *node) {
+  _value = nullptr;
+  node->accept(this, 0);
+  ir::instruction *value = _value;
+  _value = nullptr;
+  if (value == nullptr) value = undef(convert(node->type())); // after a type error
+  return value;
+}
+
+// Control flow out of unreachable code is dropped, so that it does not reach phis.
+void xpl::ir_builder::jump(ir::block *to) {
+  if (!reachable()) return;
+  ir::instruction *i = make(ir::op::JMP, ir::type::VOID);
+  i->targets.push_back(to);
+  to->preds.push_back(_current);
+}
+
+void xpl::ir_builder::branch(ir::instruction *cond, ir::block *yes, ir::block *no) {
+  if (!reachable()) return;
+  ir::instruction *i = make(ir::op::BR, ir::type::VOID, { cond });
+  i->targets = { yes, no };
+  yes->preds.push_back(_current);
+  no->preds.push_back(_current);
+}
+
+// targets[0] when no case matches
+void xpl::ir_builder::dispatch(ir::instruction *value, const std::vector<ir::instruction*> &cases,
+                               const std::vector<ir::block*> &targets) {
+  if (!reachable()) return;
+  ir::instruction *i = make(ir::op::SWITCH, ir::type::VOID, { value });
+  for (auto c : cases)
+    i->add(c);
+  i->targets = targets;
+  for (auto t : targets)
+    t->preds.push_back(_current);
+}
+
+void xpl::ir_builder::enter(ir::block *b) {
+  _current = b;
+}
+
+bool xpl::ir_builder::reachable() {
+  return _current == _fn->blocks[0].get() || !_current->preds.empty();
+}
+
+// Code after return/next/stop goes to a block nobody jumps to.
+void xpl::ir_builder::unreachable() {
+  _current = _fn->make_block();
+  _sealed.insert(_current);
+}
+
+int xpl::ir_builder::temporary(ir::type ty) {
+  _vartypes.push_back(ty);
+  return _vartypes.size() - 1;
+}
+
+void xpl::ir_builder::declare(const std::shared_ptr<xpl::symbol> &symbol, ir::type ty) {
+  if (_addressed.count(symbol->name()))
+    _slots[symbol.get()] = entry(ir::op::SLOT, ir::type::POINTER);
+  else
+    _vars[symbol.get()] = temporary(ty);
+}
+
+// Is the lvalue an SSA variable? If so, which one.
+bool xpl::ir_builder::ssa(cdk::lvalue_node *lvalue, int &var) {
+  auto id = dynamic_cast<cdk::identifier_node*>(lvalue);
+  if (id == nullptr) return false;
+  auto symbol = _symtab.find(id->name());
+  if (symbol == nullptr) return false;
+  if (symbol.get() == _self) {
+    var = _retvar;
+    return _retvar >= 0;
+  }
+  auto it = _vars.find(symbol.get());
+  if (it == _vars.end()) return false;
+  var = it->second;
+  return true;
+}
+
+xpl::ir::instruction *xpl::ir_builder::address(cdk::lvalue_node *lvalue) {
+  auto id = dynamic_cast<cdk::identifier_node*>(lvalue);
+  if (id == nullptr) return evaluate(lvalue);   // index
+
+  auto symbol = _symtab.find(id->name());
+  if (symbol == nullptr) return undef(ir::type::POINTER);
+  if (symbol->toImport()) _imports.insert(id->name());
+  if (symbol.get() == _self && _retslot != nullptr) return _retslot;
+  auto it = _slots.find(symbol.get());
+  if (it != _slots.end()) return it->second;
+
+  ir::instruction *global = make(ir::op::GLOBAL, ir::type::POINTER);
+  global->sval = id->name();
+  return global;
+}
+
+void xpl::ir_builder::assign(cdk::lvalue_node *lvalue, ir::instruction *value) {
+  int var;
+  if (ssa(lvalue, var)) {
+    write(var, _current, value);
+    return;
+  }
+  ir::instruction *where = address(lvalue);
+  make(ir::op::STORE, ir::type::VOID, { where, value });
+}
+
+void xpl::ir_builder::binary(cdk::binary_expression_node * const node, ir::op code) {
+  ir::type ty = convert(node->type());
+  ir::instruction *left = as(evaluate(node->left()), ty);
+  ir::instruction *right = as(evaluate(node->right()), ty);
+  _value = make(code, ty, { left, right });
+}
+
+void xpl::ir_builder::compare(cdk::binary_expression_node * const node, ir::op code) {
+  ir::instruction *left = evaluate(node->left());
+  ir::instruction *right = evaluate(node->right());
+  if (left->ty == ir::type::REAL || right->ty == ir::type::REAL) {
+    left = to_real(left);
+    right = to_real(right);
+  }
+  _value = make(code, ir::type::INT, { left, right });
+}
+
+//---------------------------------------------------------------------------
+//     FUNCTIONS
+//---------------------------------------------------------------------------
+
+std::unique_ptr<xpl::ir::function> xpl::ir_builder::build(xpl::function_node * const node,
+                                                          const std::shared_ptr<xpl::symbol> &symbol,
+                                                          const std::string &name) {
+  int errors = _compiler->errors();
+
+  _fn.reset(new ir::function);
+  _fn->name = name;
+  _fn->ret = convert(node->type());
+  _fn->exported = node->toExport();
+  _fn->profiled = _profile != nullptr && _profile->loaded();
+  if (debug()) _fn->source = _compiler->ifile();
+  _fn->line = _line = node->lineno();
+  _vars.clear();
+  _slots.clear();
+  _vartypes.clear();
+  _defs.clear();
+  _incomplete.clear();
+  _sealed.clear();
+  _undefs.clear();
+  _retvar = -1;
+  _retslot = nullptr;
+  _self = symbol.get();
+  enter(_fn->make_block());
+  _sealed.insert(_current);
+
+  xpl::fingerprint fp(_compiler);
+  node->accept(&fp, 0);
+  _addressed = fp.addressed();
+
+  _symtab.push();
+
+  // arguments: the caller left them above the return address (or, the first ones, in registers)
+  if (node->argument() != nullptr) {
+    int offset = 8;
+    long registers = _fn->registers = symbol->registers();
+    for (size_t i = 0; i < node->argument()->size(); i++) {
+      auto decl = dynamic_cast<xpl::decl_variable_node*>(node->argument()->node(i));
+      if (decl == nullptr) continue;
+      const std::string &id = *decl->name();
+      long place = (long)i < registers ? -(long)i - 1 : offset;
+      auto arg = std::make_shared<xpl::symbol>(decl->toImport(), true, false, false, decl->type(), id,
+                                               place);
+      _symtab.insert(id, arg);
+      _defined.insert(id);
+      ir::type ty = convert(decl->type());
+      _fn->params.push_back(ty);
+      if (_addressed.count(id) && place < 0) {   // a register has no address: copied to a slot
+        ir::instruction *value = make(ir::op::ARG, ty);
+        value->ival = place;
+        _slots[arg.get()] = entry(ir::op::SLOT, ir::type::POINTER);
+        make(ir::op::STORE, ir::type::VOID, { _slots[arg.get()], value });
+      } else if (_addressed.count(id)) {
+        _slots[arg.get()] = entry(ir::op::SLOT, ir::type::POINTER);
+        _slots[arg.get()]->ival = offset;
+      } else {
+        int var = temporary(ty);
+        _vars[arg.get()] = var;
+        ir::instruction *value = make(ir::op::ARG, ty);
+        value->ival = place;
+        write(var, _current, value);
+      }
+      if (place > 0) offset += decl->type()->size();
+    }
+  }
+
+  // the function's name is its result, initialized with the literal (if any)
+  if (_fn->ret != ir::type::VOID) {
+    ir::instruction *init = undef(_fn->ret);
+    if (node->literal() != nullptr) init = as(evaluate(node->literal()), _fn->ret);
+    if (_addressed.count(symbol->name())) {
+      _retslot = entry(ir::op::SLOT, ir::type::POINTER);
+      if (node->literal() != nullptr) {
+        make(ir::op::STORE, ir::type::VOID, { _retslot, init });
+      }
+    } else {
+      _retvar = temporary(_fn->ret);
+      write(_retvar, _current, init);
+    }
+  }
+
+  node->body()->accept(this, 0);
+  do_return_node(nullptr, 0);
+
+  for (auto &b : _fn->blocks)
+    seal(b.get());
+
+  _symtab.pop();
+
+  _self = nullptr;
+  if (_compiler->errors() != errors) return nullptr;
+  _fn->prune();
+  try {
+    _fn->verify();
+  } catch (const std::string &problem) {
+    _compiler->error(node->lineno(), problem);
+    return nullptr;
+  }
+  return std::move(_fn);
+}
+
+//---------------------------------------------------------------------------
+
+void xpl::ir_builder::do_sequence_node(cdk::sequence_node * const node, int lvl) {
+  if (lvl == 0) _external = xpl::external_functions(node);  // the program (the "ir" target)
+  int line = _line;    // what follows the statements belongs to the outer one
+  for (size_t i = 0; i < node->size(); i++)
+    if (node->node(i) != nullptr) {
+      _line = node->node(i)->lineno();
+      node->node(i)->accept(this, lvl + 2);
+    }
+  _line = line;
+}
+
+//------------ LITERALS -----------------------------------------------------
+
+void xpl::ir_builder::do_integer_node(cdk::integer_node * const node, int lvl) {
+  _value = constant(node->value());
+  if (node->type() != nullptr && node->type()->name() == basic_type::TYPE_DOUBLE)
+    _value = to_real(_value);
+}
+
+void xpl::ir_builder::do_double_node(cdk::double_node * const node, int lvl) {
+  _value = make(ir::op::DCONST, ir::type::REAL);
+  _value->dval = node->value();
+}
+
+void xpl::ir_builder::do_string_node(cdk::string_node * const node, int lvl) {
+  _value = make(ir::op::SCONST, ir::type::STRING);
+  _value->sval = node->value();
+}
+
+//------------ UNARY EXPRESSIONS --------------------------------------------
+
+void xpl::ir_builder::do_neg_node(cdk::neg_node * const node, int lvl) {
+  ASSERT_SAFE_EXPRESSIONS;
+  ir::type ty = convert(node->type());
+  ir::instruction *value = as(evaluate(node->argument()), ty);
+  _value = make(ir::op::NEG, ty, { value });
+}
+
+void xpl::ir_builder::do_not_node(cdk::not_node * const node, int lvl) {
+  ASSERT_SAFE_EXPRESSIONS;
+  ir::instruction *value = evaluate(node->argument());
+  _value = make(ir::op::NOT, ir::type::INT, { value });
+}
+
+// Absolute value (|x| in XPL): a small diamond
+void xpl::ir_builder::do_identity_node(xpl::identity_node * const node, int lvl) {
+  ASSERT_SAFE_EXPRESSIONS;
+  ir::type ty = convert(node->type());
+  ir::instruction *value = as(evaluate(node->argument()), ty);
+  int result = temporary(ty);
+  write(result, _current, value);
+
+  ir::instruction *zero = as(constant(0), ty);
+  ir::instruction *negative = make(ir::op::LE, ir::type::INT, { value, zero });
+
+  ir::block *neg = _fn->make_block(), *end = _fn->make_block();
+  branch(negative, neg, end);
+  seal(neg);
+  enter(neg);
+  ir::instruction *opposite = make(ir::op::NEG, ty, { value });
+  write(result, _current, opposite);
+  jump(end);
+  seal(end);
+  enter(end);
+  _value = read(result, _current);
+}
+
+void xpl::ir_builder::do_memalloc_node(xpl::memalloc_node * const node, int lvl) {
+  ASSERT_SAFE_EXPRESSIONS;
+  ir::instruction *size = constant(node->type()->subtype()->size());
+  ir::instruction *count = evaluate(node->argument());
+  ir::instruction *bytes = make(ir::op::MUL, ir::type::INT, { size, count });
+  _value = make(ir::op::ALLOC, ir::type::POINTER, { bytes });
+}
+
+void xpl::ir_builder::do_address_node(xpl::address_node * const node, int lvl) {
+  ASSERT_SAFE_EXPRESSIONS;
+  auto lvalue = dynamic_cast<cdk::lvalue_node*>(node->argument());
+  _value = lvalue != nullptr ? address(lvalue) : evaluate(node->argument());
+}
+
+//------------ BINARY EXPRESSIONS -------------------------------------------
+
+void xpl::ir_builder::do_add_node(cdk::add_node * const node, int lvl) {
+  ASSERT_SAFE_EXPRESSIONS;
+  if (node->type()->name() != basic_type::TYPE_POINTER) {
+    binary(node, ir::op::ADD);
+    return;
+  }
+
+  // pointer arithmetic: the pointer first, then the scaled shift
+  bool left = node->left()->type()->name() == basic_type::TYPE_POINTER;
+  cdk::expression_node *pointer = left ? node->left() : node->right();
+  cdk::expression_node *shift = left ? node->right() : node->left();
+  ir::instruction *base = evaluate(pointer);
+  ir::instruction *count = evaluate(shift);
+  ir::instruction *size = constant(pointer->type()->subtype()->size());
+  ir::instruction *bytes = make(ir::op::MUL, ir::type::INT, { count, size });
+  _value = make(ir::op::ADD, ir::type::POINTER, { base, bytes });
+}
+
+void xpl::ir_builder::do_sub_node(cdk::sub_node * const node, int lvl) {
+  ASSERT_SAFE_EXPRESSIONS;
+  if (node->type()->name() != basic_type::TYPE_POINTER) {
+    binary(node, ir::op::SUB);
+    return;
+  }
+
+  int size = node->left()->type()->subtype()->size();
+  ir::instruction *left = evaluate(node->left());
+  ir::instruction *right = evaluate(node->right());
+  if (node->right()->type()->name() == basic_type::TYPE_POINTER) {
+    // difference of pointers: number of objects between them (an integer)
+    ir::instruction *bytes = make(ir::op::SUB, ir::type::INT, { left, right });
+    _value = make(ir::op::DIV, ir::type::INT, { bytes, constant(size) });
+    node->type(new basic_type(4, basic_type::TYPE_INT));
+  } else {
+    ir::instruction *bytes = make(ir::op::MUL, ir::type::INT, { right, constant(size) });
+    _value = make(ir::op::SUB, ir::type::POINTER, { left, bytes });
+  }
+}
+
+void xpl::ir_builder::do_mul_node(cdk::mul_node * const node, int lvl) {
+  ASSERT_SAFE_EXPRESSIONS;
+  binary(node, ir::op::MUL);
+}
+void xpl::ir_builder::do_div_node(cdk::div_node * const node, int lvl) {
+  ASSERT_SAFE_EXPRESSIONS;
+  binary(node, ir::op::DIV);
+}
+void xpl::ir_builder::do_mod_node(cdk::mod_node * const node, int lvl) {
+  ASSERT_SAFE_EXPRESSIONS;
+  binary(node, ir::op::MOD);
+}
+
+void xpl::ir_builder::do_lt_node(cdk::lt_node * const node, int lvl) {
+  ASSERT_SAFE_EXPRESSIONS;
+  compare(node, ir::op::LT);
+}
+void xpl::ir_builder::do_le_node(cdk::le_node * const node, int lvl) {
+  ASSERT_SAFE_EXPRESSIONS;
+  compare(node, ir::op::LE);
+}
+void xpl::ir_builder::do_ge_node(cdk::ge_node * const node, int lvl) {
+  ASSERT_SAFE_EXPRESSIONS;
+  compare(node, ir::op::GE);
+}
+void xpl::ir_builder::do_gt_node(cdk::gt_node * const node, int lvl) {
+  ASSERT_SAFE_EXPRESSIONS;
+  compare(node, ir::op::GT);
+}
+void xpl::ir_builder::do_ne_node(cdk::ne_node * const node, int lvl) {
+  ASSERT_SAFE_EXPRESSIONS;
+  compare(node, ir::op::NE);
+}
+void xpl::ir_builder::do_eq_node(cdk::eq_node * const node, int lvl) {
+  ASSERT_SAFE_EXPRESSIONS;
+  compare(node, ir::op::EQ);
+}
+
+// Short-circuit: the result (0 or 1) is a temporary joined at the end
+void xpl::ir_builder::do_and_node(cdk::and_node * const node, int lvl) {
+  ASSERT_SAFE_EXPRESSIONS;
+  int result = temporary(ir::type::INT);
+  ir::instruction *left = evaluate(node->left());
+  write(result, _current, constant(0));
+
+  ir::block *rhs = _fn->make_block(), *end = _fn->make_block();
+  branch(left, rhs, end);
+  seal(rhs);
+  enter(rhs);
+  ir::instruction *right = make(ir::op::NE, ir::type::INT, { evaluate(node->right()), constant(0) });
+  write(result, _current, right);
+  jump(end);
+  seal(end);
+  enter(end);
+  _value = read(result, _current);
+}
+
+void xpl::ir_builder::do_or_node(cdk::or_node * const node, int lvl) {
+  ASSERT_SAFE_EXPRESSIONS;
+  int result = temporary(ir::type::INT);
+  ir::instruction *left = evaluate(node->left());
+  write(result, _current, constant(1));
+
+  ir::block *rhs = _fn->make_block(), *end = _fn->make_block();
+  branch(left, end, rhs);
+  seal(rhs);
+  enter(rhs);
+  ir::instruction *right = make(ir::op::NE, ir::type::INT, { evaluate(node->right()), constant(0) });
+  write(result, _current, right);
+  jump(end);
+  seal(end);
+  enter(end);
+  _value = read(result, _current);
+}
+
+//------------ EXPRESSIONS --------------------------------------------------
+
+void xpl::ir_builder::do_identifier_node(cdk::identifier_node * const node, int lvl) {
+  ASSERT_SAFE_EXPRESSIONS;
+  _value = address(node);
+}
+
+void xpl::ir_builder::do_rvalue_node(cdk::rvalue_node * const node, int lvl) {
+  ASSERT_SAFE_EXPRESSIONS;
+  int var;
+  if (ssa(node->lvalue(), var)) {
+    _value = read(var, _current);
+    return;
+  }
+  ir::instruction *where = address(node->lvalue());
+  _value = make(ir::op::LOAD, convert(node->lvalue()->type()), { where });
+}
+
+void xpl::ir_builder::do_assignment_node(cdk::assignment_node * const node, int lvl) {
+  ASSERT_SAFE_EXPRESSIONS;
+  ir::instruction *value = as(evaluate(node->rvalue()), convert(node->lvalue()->type()));
+  assign(node->lvalue(), value);
+  _value = value;
+}
+
+void xpl::ir_builder::do_funcall_node(xpl::funcall_node * const node, int lvl) {
+  ASSERT_SAFE_EXPRESSIONS;
+  const std::string &id = *node->name();
+  auto symbol = _symtab.find(id);
+  if (symbol->toImport()) _imports.insert(id);
+
+  // arguments are evaluated last to first (as they are pushed), converted to the parameter types
+  std::vector<basic_type> params = symbol->getArgs();
+  size_t count = node->argument() == nullptr ? 0 : node->argument()->size();
+  std::vector<ir::instruction*> args(count);
+  for (size_t i = count; i-- > 0;) {
+    auto arg = dynamic_cast<cdk::expression_node*>(node->argument()->node(i));
+    args[i] = evaluate(arg);
+    if (i < params.size()) args[i] = as(args[i], convert(&params[i]));
+  }
+
+  _value = make(ir::op::CALL, convert(node->type()));
+  _value->sval = id;
+  _value->ival = symbol->registers();
+  for (auto arg : args)
+    _value->add(arg);
+  if (_value->ty == ir::type::VOID) _value = nullptr;
+}
+
+void xpl::ir_builder::do_index_node(xpl::index_node * const node, int lvl) {
+  ASSERT_SAFE_EXPRESSIONS;
+  ir::instruction *base = evaluate(node->expression());
+  ir::instruction *count = evaluate(node->shift());
+  ir::instruction *size = constant(node->expression()->type()->subtype()->size());
+  ir::instruction *bytes = make(ir::op::MUL, ir::type::INT, { count, size });
+  _value = make(ir::op::ADD, ir::type::POINTER, { base, bytes });
+}
+
+void xpl::ir_builder::do_read_node(xpl::read_node * const node, int lvl) {
+  ASSERT_SAFE_EXPRESSIONS;
+  bool real = node->type()->name() == basic_type::TYPE_DOUBLE;
+  _value = make(ir::op::CALL, real ? ir::type::REAL : ir::type::INT);
+  _value->sval = real ? "readd" : "readi";
+}
+
+//------------ BASIC NODES --------------------------------------------------
+
+void xpl::ir_builder::do_body_node(xpl::body_node * const node, int lvl) {
+  if (node->declarations()) node->declarations()->accept(this, lvl + 2);
+  if (node->instructions()) node->instructions()->accept(this, lvl + 2);
+}
+
+void xpl::ir_builder::do_block_node(xpl::block_node * const node, int lvl) {
+  _symtab.push();
+  if (node->declarations()) node->declarations()->accept(this, lvl + 2);
+  if (node->instructions()) node->instructions()->accept(this, lvl + 2);
+  _symtab.pop();
+}
+
+void xpl::ir_builder::do_evaluation_node(xpl::evaluation_node * const node, int lvl) {
+  ASSERT_SAFE_EXPRESSIONS;
+  _value = nullptr;
+  node->argument()->accept(this, lvl + 2);
+  _value = nullptr;
+}
+
+void xpl::ir_builder::do_print_node(xpl::print_node * const node, int lvl) {
+  ASSERT_SAFE_EXPRESSIONS;
+  ir::instruction *value = evaluate(node->argument());
+  const char *printer = value->ty == ir::type::INT ? "printi" : value->ty == ir::type::REAL ? "printd" :
+                        value->ty == ir::type::STRING ? "prints" : nullptr;
+  if (printer == nullptr) {
+    _compiler->error(node->lineno(), "Print error: Can't print " + std::string(ir::name(value->ty)));
+    return;
+  }
+  ir::instruction *call = make(ir::op::CALL, ir::type::VOID);
+  call->sval = printer;
+  call->add(value);
+  if (node->newline()) make(ir::op::CALL, ir::type::VOID)->sval = "println";
+}
+
+void xpl::ir_builder::do_next_node(xpl::next_node * const node, int lvl) {
+  if (_nextList.empty()) {
+    _compiler->error(node->lineno(), "Next outside loop.");
+    return;
+  }
+  jump(_nextList.back());
+  unreachable();
+}
+
+void xpl::ir_builder::do_stop_node(xpl::stop_node * const node, int lvl) {
+  if (_stopList.empty()) {
+    _compiler->error(node->lineno(), "Stop outside loop.");
+    return;
+  }
+  jump(_stopList.back());
+  unreachable();
+}
+
+// Also used (with a null node) at the end of the function body
+void xpl::ir_builder::do_return_node(xpl::return_node * const node, int lvl) {
+  ir::instruction *value = nullptr;
+  if (_retvar >= 0) {
+    value = read(_retvar, _current);
+  } else if (_retslot != nullptr) {
+    value = make(ir::op::LOAD, _fn->ret, { _retslot });
+  }
+  ir::instruction *ret = make(ir::op::RET, ir::type::VOID);
+  if (value != nullptr) ret->add(value);
+  unreachable();
+}
+
+//------------ BASIC NODES - DECLARATION ------------------------------------
+
+void xpl::ir_builder::do_decl_variable_node(xpl::decl_variable_node * const node, int lvl) {
+  ASSERT_SAFE_EXPRESSIONS;
+  const std::string &id = *node->name();
+  auto symbol = std::make_shared<xpl::symbol>(node->toImport(), _fn != nullptr, false, false,
+                                              node->type(), id, 0);
+  _symtab.insert(id, symbol);
+  if (node->toImport()) return;
+  _defined.insert(id);
+  if (_fn == nullptr) return;           // globals are only declared (the writer defines them)
+
+  ir::type ty = convert(node->type());
+  declare(symbol, ty);
+  if (node->init() != nullptr) {
+    ir::instruction *value = as(evaluate(node->init()), ty);
+    if (_slots.count(symbol.get())) {
+      make(ir::op::STORE, ir::type::VOID, { _slots[symbol.get()], value });
+    } else {
+      write(_vars[symbol.get()], _current, value);
+    }
+  }
+}
+
+void xpl::ir_builder::do_decl_function_node(xpl::decl_function_node * const node, int lvl) {
+  ASSERT_SAFE_EXPRESSIONS;
+  const std::string &id = *node->name();
+  auto symbol = std::make_shared<xpl::symbol>(node->toImport(), true, true, false, node->type(), id, 0);
+  symbol->internal(_external.count(id) == 0);
+  for (size_t i = 0; i < node->argument()->size(); i++) {
+    auto decl = dynamic_cast<xpl::decl_variable_node*>(node->argument()->node(i));
+    if (decl != nullptr) symbol->addArg(*decl->type());
+  }
+  if (!_symtab.insert(id, symbol))
+    _compiler->error(node->lineno(), "Error inserting new function " + id + " symbol.");
+}
+
+// At the top level (the "ir" target): declare the function and build its IR
+void xpl::ir_builder::do_function_node(xpl::function_node * const node, int lvl) {
+  ASSERT_SAFE_EXPRESSIONS;
+  const std::string &id = *node->name();
+  auto symbol = _symtab.find(id);
+  _defined.insert(id);
+  if (symbol == nullptr) {
+    symbol = std::make_shared<xpl::symbol>(node->toImport(), true, true, true, node->type(), id, 0);
+    symbol->internal(_external.count(id) == 0);
+    _symtab.insert(id, symbol);
+  }
+  if (node->argument() != nullptr && symbol->getArgs().empty()) {
+    for (size_t i = 0; i < node->argument()->size(); i++) {
+      auto decl = dynamic_cast<xpl::decl_variable_node*>(node->argument()->node(i));
+      if (decl != nullptr) symbol->addArg(*decl->type());
+    }
+  }
+  symbol->value(-node->type()->size());
+
+  std::string name = id == "xpl" ? "_main" : id == "_main" ? "._main" : id;
+  auto fn = build(node, symbol, name);
+  if (fn != nullptr) _functions.push_back(std::move(fn));
+}
+
+//------------ BASIC NODES - CONDITION --------------------------------------
+
+// An arm that never ran: its entry and the blocks made for it (from first on) go last.
+void xpl::ir_builder::cold(const cdk::basic_node *node, int arm, ir::block *entry, size_t first) {
+  if (_profile == nullptr || !_profile->cold(node, arm)) return;
+  entry->heat = -1;
+  for (size_t k = first; k < _fn->blocks.size(); k++)
+    _fn->blocks[k]->heat = -1;
+}
+
+void xpl::ir_builder::do_if_node(xpl::if_node * const node, int lvl) {
+  ASSERT_SAFE_EXPRESSIONS;
+  ir::instruction *cond = evaluate(node->condition());
+  ir::block *then = _fn->make_block(), *end = _fn->make_block();
+  branch(cond, then, end);
+  seal(then);
+  enter(then);
+  size_t first = _fn->blocks.size();
+  node->block()->accept(this, lvl + 2);
+  cold(node, 0, then, first);
+  jump(end);
+  seal(end);
+  enter(end);
+}
+
+void xpl::ir_builder::do_if_else_node(xpl::if_else_node * const node, int lvl) {
+  ASSERT_SAFE_EXPRESSIONS;
+
+  // elsif chains testing one variable against 4 or more literals become switches
+  if (_chained.erase(node) == 0) {   // or were read with their head
+    xpl::switch_chain chain(_compiler, _symtab, this, node);
+    _chained.insert(chain.chained.begin(), chain.chained.end());
+    if (chain.arms.size() >= ir::SWITCH_CASES) {
+      ir::instruction *value = evaluate(chain.scrutinee);
+      std::vector<ir::instruction*> cases;
+      std::vector<ir::block*> targets = { _fn->make_block() };
+      for (auto &arm : chain.arms) {
+        cases.push_back(constant(arm.first));
+        targets.push_back(_fn->make_block());
+      }
+      ir::block *end = _fn->make_block();
+      dispatch(value, cases, targets);
+      for (auto t : targets)
+        seal(t);
+      for (size_t k = 0; k < chain.arms.size(); k++) {
+        enter(targets[k + 1]);
+        chain.arms[k].second->accept(this, lvl + 2);
+        jump(end);
+      }
+      enter(targets[0]);
+      if (chain.otherwise != nullptr) chain.otherwise->accept(this, lvl + 2);
+      jump(end);
+      seal(end);
+      enter(end);
+      return;
+    }
+  }
+
+  ir::instruction *cond = evaluate(node->condition());
+  ir::block *then = _fn->make_block(), *otherwise = _fn->make_block(), *end = _fn->make_block();
+  branch(cond, then, otherwise);
+  seal(then);
+  seal(otherwise);
+  enter(then);
+  size_t first = _fn->blocks.size();
+  node->thenblock()->accept(this, lvl + 2);
+  cold(node, 0, then, first);
+  jump(end);
+  enter(otherwise);
+  first = _fn->blocks.size();
+  node->elseblock()->accept(this, lvl + 2);
+  cold(node, 1, otherwise, first);
+  jump(end);
+  seal(end);
+  enter(end);
+}
+
+//------------ BASIC NODES - ITERATION --------------------------------------
+
+void xpl::ir_builder::do_sweep_node(xpl::sweep_node * const node, int lvl) {
+  ASSERT_SAFE_EXPRESSIONS;
+  ir::type ty = convert(node->lvalue()->type());
+  auto current = [this, node, ty]() -> ir::instruction* {
+    int var;
+    if (ssa(node->lvalue(), var)) return read(var, _current);
+    ir::instruction *where = address(node->lvalue());
+    ir::instruction *value = make(ir::op::LOAD, ty, { where });
+    return value;
+  };
+
+  assign(node->lvalue(), as(evaluate(node->init()), ty));
+
+  ir::block *header = _fn->make_block(), *body = _fn->make_block();
+  ir::block *next = _fn->make_block(), *end = _fn->make_block();
+  if (_profile != nullptr && _profile->hot(node)) header->heat = 1;
+  jump(header);
+  enter(header);
+
+  // sweep up: while lvalue <= condition; sweep down: while lvalue >= condition
+  ir::instruction *value = current();
+  ir::instruction *limit = evaluate(node->condition());
+  if (value->ty == ir::type::REAL || limit->ty == ir::type::REAL) {
+    value = to_real(value);
+    limit = to_real(limit);
+  }
+  ir::instruction *cond = make(node->signal() ? ir::op::LE : ir::op::GE, ir::type::INT, { value, limit });
+  branch(cond, body, end);
+  seal(body);
+
+  _nextList.push_back(next);
+  _stopList.push_back(end);
+  enter(body);
+  node->block()->accept(this, lvl + 2);
+  jump(next);
+  _nextList.pop_back();
+  _stopList.pop_back();
+
+  seal(next);
+  enter(next);
+  value = current();
+  ir::instruction *step = evaluate(node->add());
+  if (ty == ir::type::POINTER) {
+    ir::instruction *size = constant(node->lvalue()->type()->subtype()->size());
+    ir::instruction *bytes = make(ir::op::MUL, ir::type::INT, { step, size });
+    step = bytes;
+  } else {
+    step = as(step, ty);
+  }
+  ir::instruction *updated = make(node->signal() ? ir::op::ADD : ir::op::SUB, ty, { value, step });
+  assign(node->lvalue(), updated);
+  jump(header);
+
+  seal(header);
+  seal(end);
+  enter(end);
+}
+
+void xpl::ir_builder::do_while_node(xpl::while_node * const node, int lvl) {
+  ASSERT_SAFE_EXPRESSIONS;
+  ir::block *header = _fn->make_block(), *body = _fn->make_block(), *end = _fn->make_block();
+  if (_profile != nullptr && _profile->hot(node)) header->heat = 1;
+  jump(header);
+  enter(header);
+  ir::instruction *cond = evaluate(node->condition());
+  branch(cond, body, end);
+  seal(body);
+
+  _nextList.push_back(header);
+  _stopList.push_back(end);
+  enter(body);
+  node->block()->accept(this, lvl + 2);
+  jump(header);
+  _nextList.pop_back();
+  _stopList.pop_back();
+
+  seal(header);
+  seal(end);
+  enter(end);
+}
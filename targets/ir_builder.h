@@ -0,0 +1,187 @@
+#ifndef __XPL_IR_BUILDER_H__
+#define __XPL_IR_BUILDER_H__
+
+#include <initializer_list>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+#include <cdk/symbol_table.h>
+#include "targets/basic_ast_visitor.h"
+#include "targets/symbol.h"
+#include "targets/ir.h"
+#include "targets/profile.h"
+
+namespace xpl {
+
+  //!
+  //! Translates function_node bodies to SSA form, following Braun et al.,
+  //! "Simple and Efficient Construction of Static Single Assignment Form"
+  //! (CC 2013): variables are looked up on demand per block, phis are placed
+  //! lazily (incomplete phis in unsealed loop headers) and trivial phis are
+  //! removed as soon as they are complete.
+  //!
+  //! The builder shares the symbol table with its caller (globals and
+  //! function signatures must already be there) and reports imported names
+  //! through the given sets, exactly like postfix_writer.
+  //!
+  class ir_builder: public basic_ast_visitor {
+    cdk::symbol_table<xpl::symbol> &_symtab;
+    std::set<std::string> &_imports;
+    std::set<std::string> &_defined;
+
+    std::unique_ptr<ir::function> _fn;
+    ir::block *_current = nullptr;
+    ir::instruction *_value = nullptr;     // result of the last expression visited
+    int _line = 0;                         // of the statement being built (see ir::instruction)
+
+    std::vector<ir::block*> _nextList;     // continue targets of enclosing loops
+    std::vector<ir::block*> _stopList;     // exit targets of enclosing loops
+    std::set<xpl::if_else_node*> _chained; // elsifs already read with the head of their chain (see switch_chain)
+
+    // variables: SSA ones are numbered; memory ones have an address (slot)
+    std::map<const xpl::symbol*, int> _vars;
+    std::map<const xpl::symbol*, ir::instruction*> _slots;
+    std::vector<ir::type> _vartypes;
+    std::set<std::string> _addressed;      // names whose address is taken (kept in memory)
+    std::set<std::string> _external;       // functions with the C calling convention (the "ir" target)
+    int _retvar = -1;                      // the function's result, if it is an SSA variable
+    ir::instruction *_retslot = nullptr;   // ... or its address, if it is not
+    const xpl::symbol *_self = nullptr;    // the function being built (its name is its result)
+    const xpl::profile *_profile = nullptr; // execution counts (may be absent)
+    std::map<ir::type, ir::instruction*> _undefs;
+
+    std::map<ir::block*, std::map<int, ir::instruction*>> _defs;
+    std::map<ir::block*, std::map<int, ir::instruction*>> _incomplete;
+    std::set<ir::block*> _sealed;
+
+    // all functions built so far (when visiting a whole program)
+    std::vector<std::unique_ptr<ir::function>> _functions;
+
+  public:
+    ir_builder(std::shared_ptr<cdk::compiler> compiler, cdk::symbol_table<xpl::symbol> &symtab,
+               std::set<std::string> &imports, std::set<std::string> &defined) :
+        basic_ast_visitor(compiler), _symtab(symtab), _imports(imports), _defined(defined) {
+    }
+
+    /**
+     * Builds (and verifies) the IR of a function whose symbol is already in
+     * the symbol table (the name is the assembly one, e.g. "_main" for
+     * "xpl"). Type errors are reported to the compiler; in that case, the
+     * result is nullptr.
+     */
+    std::unique_ptr<ir::function> build(xpl::function_node * const node,
+                                        const std::shared_ptr<xpl::symbol> &symbol,
+                                        const std::string &name);
+
+    std::vector<std::unique_ptr<ir::function>> &functions() {
+      return _functions;
+    }
+
+    /** Blocks get their heat from the given execution counts (see ir::block). */
+    void profile(const xpl::profile *profile) {
+      _profile = profile;
+    }
+
+  private:
+    static ir::type convert(basic_type *type);
+
+    // SSA construction (Braun et al.)
+    void write(int var, ir::block *b, ir::instruction *value);
+    ir::instruction *read(int var, ir::block *b);
+    ir::instruction *read_recursive(int var, ir::block *b);
+    ir::instruction *add_phi_operands(int var, ir::instruction *phi);
+    ir::instruction *try_remove_trivial_phi(ir::instruction *phi);
+    void seal(ir::block *b);
+
+    // helpers
+    ir::instruction *make(ir::op code, ir::type ty);
+    ir::instruction *make(ir::op code, ir::type ty, std::initializer_list<ir::instruction*> operands);
+    ir::instruction *entry(ir::op code, ir::type ty);
+    ir::instruction *undef(ir::type ty);
+    ir::instruction *constant(int value);
+    ir::instruction *to_real(ir::instruction *value);
+    ir::instruction *as(ir::instruction *value, ir::type ty);
+    ir::instruction *evaluate(cdk::expression_node *node);
+    void jump(ir::block *to);
+    void branch(ir::instruction *cond, ir::block *yes, ir::block *no);
+    void dispatch(ir::instruction *value, const std::vector<ir::instruction*> &cases,
+                  const std::vector<ir::block*> &targets);
+    void enter(ir::block *b);
+    bool reachable();
+    void unreachable();
+    int temporary(ir::type ty);
+    void declare(const std::shared_ptr<xpl::symbol> &symbol, ir::type ty);
+    bool ssa(cdk::lvalue_node *lvalue, int &var);
+    ir::instruction *address(cdk::lvalue_node *lvalue);
+    void assign(cdk::lvalue_node *lvalue, ir::instruction *value);
+    void binary(cdk::binary_expression_node * const node, ir::op code);
+    void cold(const cdk::basic_node *node, int arm, ir::block *entry, size_t first);
+    void compare(cdk::binary_expression_node * const node, ir::op code);
+
+  public:
+    void do_sequence_node(cdk::sequence_node * const node, int lvl);
+
+  public: // literals
+    void do_integer_node(cdk::integer_node * const node, int lvl);
+    void do_double_node(cdk::double_node * const node, int lvl);
+    void do_string_node(cdk::string_node * const node, int lvl);
+
+  public: // unary expressions
+    void do_neg_node(cdk::neg_node * const node, int lvl);
+    void do_not_node(cdk::not_node * const node, int lvl);
+    void do_identity_node(xpl::identity_node * const node, int lvl);
+    void do_memalloc_node(xpl::memalloc_node * const node, int lvl);
+    void do_address_node(xpl::address_node * const node, int lvl);
+
+  public: // binary expressions
+    void do_add_node(cdk::add_node * const node, int lvl);
+    void do_sub_node(cdk::sub_node * const node, int lvl);
+    void do_mul_node(cdk::mul_node * const node, int lvl);
+    void do_div_node(cdk::div_node * const node, int lvl);
+    void do_mod_node(cdk::mod_node * const node, int lvl);
+    void do_lt_node(cdk::lt_node * const node, int lvl);
+    void do_le_node(cdk::le_node * const node, int lvl);
+    void do_ge_node(cdk::ge_node * const node, int lvl);
+    void do_gt_node(cdk::gt_node * const node, int lvl);
+    void do_ne_node(cdk::ne_node * const node, int lvl);
+    void do_eq_node(cdk::eq_node * const node, int lvl);
+    void do_and_node(cdk::and_node * const node, int lvl);
+    void do_or_node(cdk::or_node * const node, int lvl);
+
+  public: // expressions
+    void do_identifier_node(cdk::identifier_node * const node, int lvl);
+    void do_rvalue_node(cdk::rvalue_node * const node, int lvl);
+    void do_assignment_node(cdk::assignment_node * const node, int lvl);
+    void do_funcall_node(xpl::funcall_node * const node, int lvl);
+    void do_index_node(xpl::index_node * const node, int lvl);
+    void do_read_node(xpl::read_node * const node, int lvl);
+
+  public: // basic nodes
+    void do_body_node(xpl::body_node * const node, int lvl);
+    void do_block_node(xpl::block_node * const node, int lvl);
+    void do_evaluation_node(xpl::evaluation_node * const node, int lvl);
+    void do_function_node(xpl::function_node * const node, int lvl);
+    void do_next_node(xpl::next_node * const node, int lvl);
+    void do_print_node(xpl::print_node * const node, int lvl);
+    void do_return_node(xpl::return_node * const node, int lvl);
+    void do_stop_node(xpl::stop_node * const node, int lvl);
+
+  public: // basic nodes - declaration
+    void do_decl_variable_node(xpl::decl_variable_node * const node, int lvl);
+    void do_decl_function_node(xpl::decl_function_node * const node, int lvl);
+
+  public: // basic nodes - condition
+    void do_if_node(xpl::if_node * const node, int lvl);
+    void do_if_else_node(xpl::if_else_node * const node, int lvl);
+
+  public: // basic nodes - iteration
+    void do_sweep_node(xpl::sweep_node * const node, int lvl);
+    void do_while_node(xpl::while_node * const node, int lvl);
+
+  };
+
+} // xpl
+
+#endif
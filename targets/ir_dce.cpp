@@ -0,0 +1,50 @@
+#include <set>
+#include <vector>
+#include "targets/ir_passes.h"
+
+//---------------------------------------------------------------------------
+
+// A slot is dead if it is only ever stored to (its address never escapes).
+static bool write_only(const xpl::ir::instruction *slot) {
+  for (auto user : slot->users)
+    if (user->code != xpl::ir::op::STORE || user->operands[1] == slot)
+      return false;
+  return true;
+}
+
+static bool critical(const xpl::ir::instruction *i) {
+  switch (i->code) {
+    case xpl::ir::op::CALL:
+    case xpl::ir::op::JMP: case xpl::ir::op::BR: case xpl::ir::op::SWITCH: case xpl::ir::op::RET:
+      return true;
+    case xpl::ir::op::STORE:
+      return !(i->operands[0]->code == xpl::ir::op::SLOT && write_only(i->operands[0]));
+    default:
+      return false;
+  }
+}
+
+bool xpl::ir::dce(function &fn) {
+  // mark: everything the effects of the function depend on
+  std::set<const instruction*> live;
+  std::vector<const instruction*> work;
+  for (auto &b : fn.blocks)
+    for (auto i : b->code)
+      if (critical(i)) work.push_back(i);
+  while (!work.empty()) {
+    const instruction *i = work.back();
+    work.pop_back();
+    if (!live.insert(i).second) continue;
+    for (auto operand : i->operands)
+      work.push_back(operand);
+  }
+
+  // sweep
+  std::vector<instruction*> dead;
+  for (auto &b : fn.blocks)
+    for (auto i : b->code)
+      if (live.count(i) == 0) dead.push_back(i);
+  for (auto i : dead)
+    fn.remove(i);
+  return !dead.empty();
+}
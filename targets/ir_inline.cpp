@@ -0,0 +1,184 @@
+#include <algorithm>
+#include <map>
+#include <vector>
+#include "targets/ir_passes.h"
+
+//---------------------------------------------------------------------------
+
+// Instructions that cost nothing once inlined (they fold into their uses).
+static bool cheap(const xpl::ir::instruction *i) {
+  switch (i->code) {
+    case xpl::ir::op::ICONST: case xpl::ir::op::DCONST: case xpl::ir::op::SCONST:
+    case xpl::ir::op::UNDEF: case xpl::ir::op::ARG: case xpl::ir::op::GLOBAL: case xpl::ir::op::SLOT:
+    case xpl::ir::op::PHI: case xpl::ir::op::JMP: case xpl::ir::op::RET:
+      return true;
+    default:
+      return false;
+  }
+}
+
+bool xpl::ir::inlinable(const function &fn, int threshold) {
+  if (fn.exported || !fn.blocks[0]->preds.empty()) return false;
+  int cost = 0;
+  for (auto &b : fn.blocks)
+    for (auto i : b->code) {
+      if (i->code == op::ALLOC) return false;                          // freed by the callee's LEAVE
+      if (i->code == op::CALL && i->sval == fn.name) return false;     // recursive
+      if (!cheap(i)) cost++;
+    }
+  return cost <= threshold;
+}
+
+//---------------------------------------------------------------------------
+
+namespace {
+
+  using namespace xpl::ir;
+
+  // Moves an instruction just made (at the end of its block) to the front of block b.
+  void hoist(instruction *i, block *b) {
+    i->parent->code.pop_back();
+    i->parent = b;
+    b->code.insert(b->code.begin(), i);
+  }
+
+  /**
+   * Replaces call (in fn) by a copy of the callee's blocks: the call's
+   * block jumps to the copy of the callee's entry, every ret jumps to a new
+   * block with the rest of the caller's block, where the result is a phi of
+   * the returned values. Arguments are the call's operands; the callee's
+   * slots (locals, and arguments whose address is taken) become slots of
+   * the caller.
+   */
+  void expand(function &fn, instruction *call, const function &callee) {
+    block *caller = call->parent;
+
+    // split the caller's block after the call
+    block *rest = fn.make_block();
+    auto at = std::find(caller->code.begin(), caller->code.end(), call);
+    rest->code.assign(at + 1, caller->code.end());
+    caller->code.erase(at + 1, caller->code.end());
+    for (auto i : rest->code)
+      i->parent = rest;
+    for (auto s : rest->succs()) {
+      std::replace(s->preds.begin(), s->preds.end(), caller, rest);
+      for (auto phi : s->code) {
+        if (phi->code != op::PHI) break;
+        std::replace(phi->targets.begin(), phi->targets.end(), caller, rest);
+      }
+    }
+
+    // arguments, by where the callee finds them (frame offset or register, see places)
+    std::map<long, instruction*> args;
+    std::vector<long> where = places(call);
+    for (size_t k = 0; k < where.size(); k++)
+      args[where[k]] = call->operands[k];
+
+    std::map<const block*, block*> blocks;
+    for (auto &b : callee.blocks)
+      blocks[b.get()] = fn.make_block();
+
+    // copy the instructions (operands are set afterwards: phis may refer to later values)
+    std::map<const instruction*, instruction*> values;
+    std::vector<std::pair<block*, instruction*>> returns;
+    for (auto &b : callee.blocks) {
+      block *copy = blocks[b.get()];
+      for (auto p : b->preds)
+        copy->preds.push_back(blocks[p]);
+      for (auto i : b->code) {
+        if (i->code == op::ARG) {
+          values[i] = args[i->ival];
+        } else if (i->code == op::SLOT) {
+          instruction *slot = fn.make(caller, op::SLOT, type::POINTER);
+          hoist(slot, fn.blocks[0].get());
+          if (i->ival > 0) {   // the argument is copied to its new home before entering
+            instruction *store = fn.make(caller, op::STORE, type::VOID);
+            store->add(slot);
+            store->add(args[i->ival]);
+          }
+          values[i] = slot;
+        } else if (i->code == op::RET) {
+          instruction *jmp = fn.make(copy, op::JMP, type::VOID);
+          jmp->targets.push_back(rest);
+          rest->preds.push_back(copy);
+          returns.push_back(std::make_pair(copy, i->operands.empty() ? nullptr : i->operands[0]));
+        } else {
+          instruction *clone = fn.make(copy, i->code, i->ty);
+          clone->ival = i->ival;
+          clone->dval = i->dval;
+          clone->sval = i->sval;
+          clone->line = i->line;
+          for (auto t : i->targets)
+            clone->targets.push_back(blocks[t]);
+          values[i] = clone;
+        }
+      }
+    }
+    for (auto &b : callee.blocks)
+      for (auto i : b->code) {
+        if (i->code == op::ARG || i->code == op::SLOT || i->code == op::RET) continue;
+        for (auto operand : i->operands)
+          values[i]->add(values[operand]);
+      }
+
+    // enter the copy
+    block *entry = blocks[callee.blocks[0].get()];
+    instruction *jmp = fn.make(caller, op::JMP, type::VOID);
+    jmp->targets.push_back(entry);
+    entry->preds.push_back(caller);
+
+    // the result
+    if (call->has_value()) {
+      instruction *result;
+      if (returns.size() == 1) {
+        result = values[returns[0].second];
+      } else {
+        result = fn.make(rest, op::PHI, call->ty);
+        for (auto &r : returns) {
+          result->add(values[r.second]);
+          result->targets.push_back(r.first);
+        }
+      }
+      call->replace_uses(result);
+    }
+    fn.remove(call);
+
+    // lay the copy out between the call and the rest of the caller's block
+    std::vector<std::unique_ptr<block>> order;
+    std::vector<std::unique_ptr<block>> moved;
+    size_t first = fn.blocks.size() - callee.blocks.size() - 1;
+    for (size_t k = first; k < fn.blocks.size(); k++)
+      moved.push_back(std::move(fn.blocks[k]));
+    fn.blocks.resize(first);
+    for (auto &b : fn.blocks) {
+      bool split = b.get() == caller;
+      order.push_back(std::move(b));
+      if (split) {
+        for (size_t k = 1; k < moved.size(); k++)
+          order.push_back(std::move(moved[k]));
+        order.push_back(std::move(moved[0]));
+      }
+    }
+    fn.blocks.swap(order);
+    for (size_t k = 0; k < fn.blocks.size(); k++)
+      fn.blocks[k]->id = k;
+  }
+
+}
+
+bool xpl::ir::inline_calls(function &fn, const library &callees) {
+  std::vector<std::pair<instruction*, const function*>> calls;
+  for (auto &b : fn.blocks)
+    for (auto i : b->code)
+      if (i->code == op::CALL) {
+        auto callee = callees.find(i->sval);
+        if (callee != callees.end() && callee->second.get() != &fn)
+          calls.push_back(std::make_pair(i, callee->second.get()));
+      }
+
+  // only the calls that were there: those in the copies are not expanded again
+  for (auto &call : calls)
+    expand(fn, call.first, *call.second);
+  if (!calls.empty()) fn.prune();  // callees that never return
+  return !calls.empty();
+}
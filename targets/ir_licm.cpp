@@ -0,0 +1,95 @@
+#include <algorithm>
+#include <map>
+#include <set>
+#include <vector>
+#include "targets/ir_passes.h"
+#include "targets/ir_loops.h"
+
+//---------------------------------------------------------------------------
+
+namespace {
+
+  using namespace xpl::ir;
+
+  // What a load reads from: a global (by name) or a slot, when the address says so.
+  bool base(const instruction *address, std::string &global, const instruction *&slot) {
+    if (address->code == op::GLOBAL) {
+      global = address->sval;
+      return true;
+    }
+    if (address->code == op::SLOT) {
+      slot = address;
+      return true;
+    }
+    return false;
+  }
+
+  /**
+   * Whether i computes the same value wherever it is placed in the loop,
+   * once its operands are outside: pure operations that cannot trap
+   * (integer division only by constants other than 0 and -1), and loads of
+   * globals and slots that nothing in the loop may write.
+   */
+  bool invariant(const instruction *i, const function &fn, const loop &l) {
+    switch (i->code) {
+      case op::ICONST: case op::DCONST: case op::SCONST: case op::UNDEF: case op::GLOBAL:
+      case op::ADD: case op::SUB: case op::MUL: case op::NEG: case op::NOT: case op::I2D:
+      case op::SHL: case op::SAR: case op::SHR: case op::MULHI:
+      case op::LT: case op::LE: case op::GT: case op::GE: case op::EQ: case op::NE:
+        return true;
+      case op::DIV: case op::MOD:
+        if (i->ty == type::REAL) return true;
+        return i->operands[1]->code == op::ICONST && i->operands[1]->ival != 0 && i->operands[1]->ival != -1;
+      case op::LOAD: {
+        std::string global;
+        const instruction *slot = nullptr;
+        if (!base(i->operands[0], global, slot)) return false;
+        for (auto id : l.body)
+          for (auto j : fn.blocks[id]->code) {
+            if (j->code == op::CALL) return false;   // calls (and reads) may write anything
+            if (j->code != op::STORE) continue;
+            std::string written;
+            const instruction *target = nullptr;
+            if (!base(j->operands[0], written, target)) return false;
+            if (written == global && target == slot) return false;
+          }
+        return true;
+      }
+      default:
+        return false;
+    }
+  }
+
+}
+
+bool xpl::ir::licm(function &fn) {
+  preheaders(fn);
+
+  bool changed = false;
+  for (auto &l : loops(fn)) {
+    block *pre = preheader(l);
+    if (pre == nullptr) continue;
+
+    // operands are hoisted before their users: repeat until nothing moves
+    for (bool moved = true; moved;) {
+      moved = false;
+      for (auto id : l.body) {
+        block *b = fn.blocks[id].get();
+        std::vector<instruction*> code = b->code;
+        for (auto i : code) {
+          if (!invariant(i, fn, l)) continue;
+          bool outside = true;
+          for (auto operand : i->operands)
+            if (l.contains(operand)) outside = false;
+          if (!outside) continue;
+
+          b->code.erase(std::find(b->code.begin(), b->code.end(), i));
+          pre->code.insert(pre->code.end() - 1, i);
+          i->parent = pre;
+          moved = changed = true;
+        }
+      }
+    }
+  }
+  return changed;
+}
@@ -0,0 +1,97 @@
+#include <algorithm>
+#include <map>
+#include "targets/ir_loops.h"
+
+//---------------------------------------------------------------------------
+
+std::vector<xpl::ir::loop> xpl::ir::loops(const function &fn) {
+  std::vector<std::set<size_t>> dom = fn.dominators();
+  std::vector<bool> reachable = fn.reachable();
+  std::map<block*, std::set<size_t>> bodies;
+  for (auto &b : fn.blocks) {
+    if (!reachable[b->id]) continue;
+    for (auto h : b->succs()) {
+      if (dom[b->id].count(h->id) == 0) continue;   // not a back edge
+      std::set<size_t> &body = bodies[h];
+      body.insert(h->id);
+      std::vector<block*> work { b.get() };
+      while (!work.empty()) {
+        block *x = work.back();
+        work.pop_back();
+        if (!body.insert(x->id).second) continue;
+        for (auto p : x->preds)
+          if (reachable[p->id]) work.push_back(p);
+      }
+    }
+  }
+  std::vector<loop> result;
+  for (auto &l : bodies)
+    result.push_back(loop { l.first, l.second });
+  std::stable_sort(result.begin(), result.end(),
+                   [](const loop &a, const loop &b) { return a.body.size() < b.body.size(); });
+  return result;
+}
+
+bool xpl::ir::basic(instruction *phi, const loop &l, const block *pre, induction &iv) {
+  iv = induction { phi, nullptr, 0 };
+  for (size_t k = 0; k < phi->operands.size(); k++) {
+    if (phi->targets[k] == pre) continue;
+    instruction *next = phi->operands[k];
+    if (iv.next != nullptr && next != iv.next) return false;
+    if (iv.next != nullptr) continue;
+    long step = 0;
+    if (next->code == op::ADD && next->operands[0] == phi && next->operands[1]->constant(step))
+      iv.step = step;
+    else if (next->code == op::ADD && next->operands[1] == phi && next->operands[0]->constant(step))
+      iv.step = step;
+    else if (next->code == op::SUB && next->operands[0] == phi && next->operands[1]->constant(step))
+      iv.step = -step;
+    else
+      return false;
+    iv.next = next;
+  }
+  return iv.next != nullptr && l.contains(iv.next);
+}
+
+xpl::ir::block *xpl::ir::entering(const loop &l) {
+  block *outside = nullptr;
+  for (auto p : l.header->preds) {
+    if (l.body.count(p->id)) continue;
+    if (outside != nullptr && outside != p) return nullptr;
+    outside = p;
+  }
+  return outside;
+}
+
+xpl::ir::block *xpl::ir::preheader(const loop &l) {
+  block *p = entering(l);
+  return p != nullptr && p->succs().size() == 1 ? p : nullptr;
+}
+
+void xpl::ir::preheaders(function &fn) {
+  for (bool split = true; split;) {
+    split = false;
+    for (auto &l : loops(fn)) {
+      block *p = entering(l);
+      if (p == nullptr || p->succs().size() == 1) continue;
+      block *pre = fn.make_block();
+      instruction *t = p->terminator();
+      std::replace(t->targets.begin(), t->targets.end(), l.header, pre);
+      std::replace(l.header->preds.begin(), l.header->preds.end(), p, pre);
+      for (auto phi : l.header->code) {
+        if (phi->code != op::PHI) break;
+        std::replace(phi->targets.begin(), phi->targets.end(), p, pre);
+      }
+      fn.make(pre, op::JMP, type::VOID)->targets.push_back(l.header);
+      pre->preds.push_back(p);
+
+      std::unique_ptr<block> moved = std::move(fn.blocks.back());
+      fn.blocks.pop_back();
+      fn.blocks.insert(fn.blocks.begin() + l.header->id, std::move(moved));
+      for (size_t k = 0; k < fn.blocks.size(); k++)
+        fn.blocks[k]->id = k;
+      split = true;
+      break;
+    }
+  }
+}
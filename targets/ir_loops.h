@@ -0,0 +1,54 @@
+#ifndef __XPL_IR_LOOPS_H__
+#define __XPL_IR_LOOPS_H__
+
+#include <set>
+#include <vector>
+#include "targets/ir.h"
+
+namespace xpl {
+  namespace ir {
+
+    //!
+    //! Natural loops, for the passes that work on them.
+    //!
+    struct loop {
+      block *header;
+      std::set<size_t> body;   // block ids (header included)
+
+      bool contains(const instruction *i) const {
+        return body.count(i->parent->id) > 0;
+      }
+    };
+
+    //!
+    //! A basic induction variable: a header phi that is init on entry and
+    //! phi + step (a constant) on every back edge.
+    //!
+    struct induction {
+      instruction *phi, *next;
+      long step;
+    };
+
+    /** @return whether phi (in l's header, entered from pre) is a basic induction variable (described in iv) */
+    bool basic(instruction *phi, const loop &l, const block *pre, induction &iv);
+
+    /** @return the natural loops (one per header, merging its back edges), innermost first */
+    std::vector<loop> loops(const function &fn);
+
+    /** @return the only predecessor of the header from outside the loop (nullptr if there are several) */
+    block *entering(const loop &l);
+
+    /** @return the entering block, if the header is its only successor (nullptr otherwise) */
+    block *preheader(const loop &l);
+
+    /**
+     * Gives every loop with a single entering block a preheader: edges that
+     * come from a branch are split with a new block, laid out just before
+     * the header.
+     */
+    void preheaders(function &fn);
+
+  } // ir
+} // xpl
+
+#endif
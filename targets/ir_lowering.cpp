@@ -0,0 +1,433 @@
+#include <algorithm>
+#include <sstream>
+#include <string>
+#include "targets/ir_lowering.h"
+#include "targets/pg_hooks.h"
+
+//---------------------------------------------------------------------------
+
+std::string xpl::ir_lowering::mklbl(int lbl) {
+  std::ostringstream oss;
+  oss << (_fn.source.empty() ? "_L" : "..@L") << _fn.name << "." << lbl;  // (see postfix_writer::mklbl)
+  return oss.str();
+}
+
+const std::string &xpl::ir_lowering::label(const ir::block *b) {
+  auto &lbl = _labels[b];
+  if (lbl == "") lbl = mklbl(++_lbl);
+  return lbl;
+}
+
+// Cheap, pure values: emitted at each use instead of being kept.
+bool xpl::ir_lowering::rematerialized(const ir::instruction *i) {
+  switch (i->code) {
+    case ir::op::ICONST: case ir::op::DCONST: case ir::op::SCONST: case ir::op::UNDEF:
+    case ir::op::ARG: case ir::op::GLOBAL: case ir::op::SLOT:
+      return true;
+    default:
+      return false;
+  }
+}
+
+// A call whose int result is not used: it is left in eax (st0 is always popped).
+bool xpl::ir_lowering::discarded(const ir::instruction *i) {
+  return i->code == ir::op::CALL && i->users.empty() && i->ty != ir::type::REAL;
+}
+
+// Operands in the order they are pushed.
+std::vector<xpl::ir::instruction*> xpl::ir_lowering::pushed(const ir::instruction *i) {
+  std::vector<ir::instruction*> operands = i->operands;
+  if (i->code == ir::op::STORE || i->code == ir::op::CALL)  // value before address; last argument first
+    std::reverse(operands.begin(), operands.end());
+  if (i->code == ir::op::PHI || i->code == ir::op::JMP || i->code == ir::op::SWITCH)
+    operands.clear();   // (the value of a switch is pushed once per test: it is kept in a slot)
+  return operands;
+}
+
+/**
+ * Marks as deferred the operands of the user computed just before it, in
+ * push order (walking backwards from pos), so that nothing changes order.
+ * Returns the position of the first instruction that is not part of the
+ * user's tree.
+ */
+int xpl::ir_lowering::defer(const std::vector<ir::instruction*> &code, const ir::instruction *user, int pos) {
+  std::vector<ir::instruction*> operands = pushed(user);
+  for (size_t k = operands.size(); k-- > 0;) {
+    ir::instruction *operand = operands[k];
+    if (rematerialized(operand)) continue;
+    while (pos >= 0 && rematerialized(code[pos])) pos--;
+    if (pos < 0 || code[pos] != operand) continue;  // computed earlier: read from its slot
+    if (operand->users.size() != 1 || operand->code == ir::op::PHI || operand->code == ir::op::ALLOC)
+      break;                                        // it must be computed here: keep the order
+                                                    // (alloc moves the stack under what is pushed)
+    _deferred.insert(operand);
+    pos = defer(code, operand, pos - 1);
+  }
+  return pos;
+}
+
+void xpl::ir_lowering::allocate() {
+  for (auto &b : _fn.blocks) {
+    if (!_reachable[b->id]) continue;
+    for (int pos = b->code.size() - 1; pos >= 0;)
+      pos = rematerialized(b->code[pos]) ? pos - 1 : defer(b->code, b->code[pos], pos - 1);
+  }
+  for (auto &b : _fn.blocks) {
+    if (!_reachable[b->id]) continue;
+    for (auto i : b->code) {
+      if (i->code == ir::op::ARG && i->ival < 0 && _spills.count(i->ival) == 0) {
+        _frame += 4;    // kept from the entry on: the register is soon overwritten
+        _spills[i->ival] = -_frame;
+      }
+      int size = 0;
+      if (i->code == ir::op::SLOT && i->ival == 0)
+        size = 8;   // a local whose address is taken
+      else if (i->has_value() && !rematerialized(i) && !_deferred.count(i) && !i->users.empty())
+        size = ir::size(i->ty);
+      if (size == 0) continue;
+      _frame += size;
+      _slots[i] = -_frame;
+    }
+  }
+}
+
+//---------------------------------------------------------------------------
+
+// Pushes a value.
+void xpl::ir_lowering::value(const ir::instruction *i) {
+  switch (i->code) {
+    case ir::op::ICONST:
+      _pf.INT(i->ival);
+      return;
+    case ir::op::DCONST:
+      if (_data.count(i) == 0) {
+        _pf.DATA();
+        _pf.ALIGN();
+        _pf.LABEL(_data[i] = mklbl(++_lbl));
+        _pf.DOUBLE(i->dval);
+        _pf.TEXT();
+      }
+      _pf.ADDR(_data[i]);
+      _pf.DLOAD();
+      return;
+    case ir::op::SCONST:
+      if (_data.count(i) == 0) {
+        _pf.RODATA();
+        _pf.ALIGN();
+        _pf.LABEL(_data[i] = mklbl(++_lbl));
+        _pf.STR(i->sval);
+        _pf.TEXT();
+      }
+      _pf.ADDR(_data[i]);
+      return;
+    case ir::op::UNDEF:
+      _pf.INT(0);
+      if (i->ty == ir::type::REAL) _pf.I2D();
+      return;
+    case ir::op::ARG:
+      if (i->ival < 0) {
+        _pf.LOCV(_spills[i->ival]);
+      } else if (i->ty == ir::type::REAL) {
+        _pf.LOCAL(i->ival);
+        _pf.DLOAD();
+      } else
+        _pf.LOCV(i->ival);
+      return;
+    case ir::op::GLOBAL:
+      _pf.ADDR(i->sval);
+      return;
+    case ir::op::SLOT:
+      _pf.LOCAL(i->ival > 0 ? i->ival : _slots[i]);
+      return;
+    default:
+      break;
+  }
+
+  if (_deferred.count(i)) {
+    compute(i);
+  } else if (i->ty == ir::type::REAL) {
+    _pf.LOCAL(_slots[i]);
+    _pf.DLOAD();
+  } else {
+    _pf.LOCV(_slots[i]);
+  }
+}
+
+// Pops a value into its slot.
+void xpl::ir_lowering::store(const ir::instruction *i) {
+  if (i->ty == ir::type::REAL) {
+    _pf.LOCAL(_slots[i]);
+    _pf.DSTORE();
+  } else
+    _pf.LOCA(_slots[i]);
+}
+
+// Emits an instruction (not a terminator): its operands, then the operation.
+void xpl::ir_lowering::compute(const ir::instruction *i) {
+  for (auto operand : pushed(i))
+    value(operand);
+
+  bool real = i->ty == ir::type::REAL;
+  switch (i->code) {
+    case ir::op::ADD: real ? _pf.DADD() : _pf.ADD(); break;
+    case ir::op::SUB: real ? _pf.DSUB() : _pf.SUB(); break;
+    case ir::op::MUL: real ? _pf.DMUL() : _pf.MUL(); break;
+    case ir::op::DIV: real ? _pf.DDIV() : _pf.DIV(); break;
+    case ir::op::MOD: _pf.MOD(); break;
+    case ir::op::SHL: _pf.SHTL(); break;
+    case ir::op::SAR: _pf.SHTRS(); break;
+    case ir::op::SHR: _pf.SHTRU(); break;
+    case ir::op::MULHI: _pf.MULHI(); break;
+    case ir::op::NEG: real ? _pf.DNEG() : _pf.NEG(); break;
+    case ir::op::NOT: _pf.NOT(); break;
+    case ir::op::I2D: _pf.I2D(); break;
+    case ir::op::LT: case ir::op::LE: case ir::op::GT: case ir::op::GE: case ir::op::EQ: case ir::op::NE:
+      if (i->operands[0]->ty == ir::type::REAL) {
+        _pf.DCMP();
+        _pf.INT(0);
+      }
+      switch (i->code) {
+        case ir::op::LT: _pf.LT(); break;
+        case ir::op::LE: _pf.LE(); break;
+        case ir::op::GT: _pf.GT(); break;
+        case ir::op::GE: _pf.GE(); break;
+        case ir::op::EQ: _pf.EQ(); break;
+        default:         _pf.NE(); break;
+      }
+      break;
+    case ir::op::LOAD: real ? _pf.DLOAD() : _pf.LOAD(); break;
+    case ir::op::STORE: i->operands[1]->ty == ir::type::REAL ? _pf.DSTORE() : _pf.STORE(); break;
+    case ir::op::ALLOC:
+      _pf.ALLOC();
+      _pf.SP();
+      break;
+    case ir::op::CALL: {
+      int bytes = 0;
+      for (auto operand : i->operands)
+        bytes += ir::size(operand->ty);
+      for (long k = 0; k < i->ival; k++) {   // the first ones are on top
+        _pf.POPR(k);
+        bytes -= 4;
+      }
+      _pf.CALL(i->sval);
+      if (bytes > 0) _pf.TRASH(bytes);
+      if (real)
+        _pf.DPUSH();
+      else if (i->has_value() && !discarded(i))
+        _pf.PUSH();
+      break;
+    }
+    default:
+      break;
+  }
+}
+
+/**
+ * Phi copies for the edge from -> to: every source is pushed before any
+ * phi is written (they are parallel assignments).
+ * @return whether there is anything to copy
+ */
+bool xpl::ir_lowering::copies(const ir::block *from, const ir::block *to, bool emit) {
+  std::vector<const ir::instruction*> phis;
+  for (auto i : to->code) {
+    if (i->code != ir::op::PHI) break;
+    if (_slots.count(i) == 0) continue;
+    for (size_t k = 0; k < i->operands.size(); k++)
+      if (i->targets[k] == from && i->operands[k] != i) {
+        if (emit) value(i->operands[k]);
+        phis.push_back(i);
+      }
+  }
+  if (emit)
+    for (size_t k = phis.size(); k-- > 0;)
+      store(phis[k]);
+  return !phis.empty();
+}
+
+void xpl::ir_lowering::emit(const ir::block *b, const ir::block *next) {
+  if (b != _fn.blocks[0].get()) {
+    if (!_fn.profiled || b->heat > 0) _pf.ALIGN();   // with a profile, hot loops only
+    _pf.LABEL(label(b));
+  }
+
+  for (auto i : b->code) {
+    if (i->terminator() || i->code == ir::op::PHI || rematerialized(i) || _deferred.count(i)) continue;
+    line(i);
+    compute(i);
+    if (_slots.count(i))
+      store(i);
+    else if (i->has_value() && !discarded(i))
+      _pf.TRASH(ir::size(i->ty));     // computed for its effects only
+  }
+
+  const ir::instruction *t = b->terminator();
+  line(t);
+  switch (t->code) {
+    case ir::op::JMP:
+      copies(b, t->targets[0], true);
+      if (t->targets[0] != next) _pf.JMP(label(t->targets[0]));
+      break;
+    case ir::op::BR: {
+      const ir::block *yes = t->targets[0], *no = t->targets[1];
+      bool stub = copies(b, no, false);
+      if (!stub && no == next && yes != next && !copies(b, yes, false)) {  // (yes was placed elsewhere)
+        value(t->operands[0]);
+        _pf.JNZ(label(yes));
+        break;
+      }
+      std::string otherwise = stub ? mklbl(++_lbl) : label(no);
+      value(t->operands[0]);
+      _pf.JZ(otherwise);
+      copies(b, yes, true);
+      if (yes != next || stub) _pf.JMP(label(yes));
+      if (stub) {
+        if (!_fn.profiled) _pf.ALIGN();
+        _pf.LABEL(otherwise);
+        copies(b, no, true);
+        _pf.JMP(label(no));
+      }
+      break;
+    }
+    case ir::op::SWITCH: {
+      // edges with phi copies go through stubs, as in BR
+      std::vector<std::pair<std::string, const ir::block*>> stubs;
+      auto target = [this, b, &stubs](const ir::block *to) -> std::string {
+        if (!copies(b, to, false)) return label(to);
+        stubs.push_back(std::make_pair(mklbl(++_lbl), to));
+        return stubs.back().first;
+      };
+      std::string none = target(t->targets[0]);
+      std::vector<std::pair<long, std::string>> cases;
+      for (size_t k = 1; k < t->operands.size(); k++) {
+        long value = 0;
+        t->operands[k]->constant(value);
+        cases.push_back(std::make_pair(value, target(t->targets[k])));
+      }
+      std::sort(cases.begin(), cases.end());
+      dispatch(t->operands[0], cases, none);
+      for (auto &stub : stubs) {
+        if (!_fn.profiled) _pf.ALIGN();
+        _pf.LABEL(stub.first);
+        copies(b, stub.second, true);
+        _pf.JMP(label(stub.second));
+      }
+      break;
+    }
+    case ir::op::RET:
+      if (!t->operands.empty()) value(t->operands[0]);
+      if (!_pgrecord.empty()) {   // (the value waits on the stack)
+        xpl::pg_hooks hooks(_pf, _pgrecord);
+        hooks.leave(_pgframe, mklbl(++_lbl));
+        if (!_pgfile.empty()) hooks.report(_pgfile);
+      }
+      if (!t->operands.empty()) t->operands[0]->ty == ir::type::REAL ? _pf.DPOP() : _pf.POP();
+      _pf.LEAVE();
+      _pf.RET();
+      break;
+    default:
+      break;
+  }
+}
+
+// Jumps to the label of the case (sorted by value) that matches, or to none, as
+// postfix_writer::dispatch does: a bounds-checked jump table or a binary search.
+void xpl::ir_lowering::dispatch(const ir::instruction *scrutinee, const std::vector<std::pair<long, std::string>> &cases,
+                                const std::string &none) {
+  long long low = cases.front().first, range = (long long)cases.back().first - low + 1;
+  if (!ir::dense(low, cases.back().first, cases.size())) {
+    search(scrutinee, cases, 0, cases.size(), none);
+    return;
+  }
+
+  // (unsigned) scrutinee - low < range, then jump through the table
+  std::string table = mklbl(++_lbl);
+  value(scrutinee);
+  _pf.INT(low);
+  _pf.SUB();
+  _pf.INT(range);
+  _pf.ULT();
+  _pf.JZ(none);
+  value(scrutinee);
+  _pf.INT(low);
+  _pf.SUB();
+  _pf.INT(2);
+  _pf.SHTL();
+  _pf.ADDR(table);
+  _pf.ADD();
+  _pf.LOAD();
+  _pf.LEAP();
+
+  _pf.RODATA();
+  _pf.ALIGN();
+  _pf.LABEL(table);
+  size_t k = 0;
+  for (long long v = low; v < low + range; v++) {
+    bool matched = cases[k].first == v;
+    _pf.ID(matched ? cases[k].second : none);
+    if (matched) k++;
+  }
+  _pf.TEXT();
+}
+
+void xpl::ir_lowering::search(const ir::instruction *scrutinee, const std::vector<std::pair<long, std::string>> &cases,
+                              size_t lo, size_t hi, const std::string &none) {
+  if (hi - lo <= 3) {
+    for (size_t k = lo; k < hi; k++) {
+      value(scrutinee);
+      _pf.INT(cases[k].first);
+      _pf.EQ();
+      _pf.JNZ(cases[k].second);
+    }
+    _pf.JMP(none);
+    return;
+  }
+  size_t mid = (lo + hi) / 2;
+  std::string lower = mklbl(++_lbl);
+  value(scrutinee);
+  _pf.INT(cases[mid].first);
+  _pf.LT();
+  _pf.JNZ(lower);
+  search(scrutinee, cases, mid, hi, none);
+  _pf.LABEL(lower);
+  search(scrutinee, cases, lo, mid, none);
+}
+
+void xpl::ir_lowering::lower() {
+  _reachable = _fn.reachable();
+  allocate();
+  if (!_pgrecord.empty()) {   // below the slots
+    _frame += 16;
+    _pgframe = -(_frame - 8);
+  }
+
+  _pf.TEXT();
+  _pf.ALIGN();
+  std::string end = mklbl(0);
+  if (_fn.source.empty()) {
+    if (_fn.exported) _pf.GLOBAL(_fn.name, _pf.FUNC());
+  } else {
+    _fn.exported ? _pf.GLOBAL(_fn.name, _pf.FUNC(_fn.name, end)) : _pf.STATIC(_fn.name, _pf.FUNC(_fn.name, end));
+    _pf.LINE(_line = _fn.line, _fn.source);
+  }
+  _pf.LABEL(_fn.name);
+  _pf.ENTER(_frame);
+  for (auto it = _spills.rbegin(); it != _spills.rend(); ++it) {  // eax (-1) first: LOCA goes through it
+    _pf.PUSHR(-it->first - 1);
+    _pf.LOCA(it->second);
+  }
+  if (!_pgrecord.empty()) xpl::pg_hooks(_pf, _pgrecord).enter(_pgframe, mklbl(++_lbl));
+
+  std::vector<const ir::block*> order;
+  for (auto &b : _fn.blocks)
+    if (_reachable[b->id]) order.push_back(b.get());
+  std::stable_partition(order.begin() + 1, order.end(),   // what never ran goes last
+                        [](const ir::block *b) { return b->heat >= 0; });
+  for (size_t k = 0; k < order.size(); k++)
+    emit(order[k], k + 1 < order.size() ? order[k + 1] : nullptr);
+  if (!_fn.source.empty()) _pf.LABEL(end);
+}
+
+void xpl::ir_lowering::line(const ir::instruction *i) {
+  if (_fn.source.empty() || i->line == 0 || i->line == _line) return;
+  _pf.LINE(_line = i->line, "");
+}
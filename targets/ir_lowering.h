@@ -0,0 +1,76 @@
+#ifndef __XPL_IR_LOWERING_H__
+#define __XPL_IR_LOWERING_H__
+
+#include <map>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+#include <cdk/emitters/basic_postfix_emitter.h>
+#include "targets/ir.h"
+
+namespace xpl {
+
+  //!
+  //! Emits the postfix code of an IR function. Values whose only use comes
+  //! right after them (in evaluation order) are left on the stack, so
+  //! expressions come out as the writer would emit them; every other value
+  //! (and every phi) gets a frame slot. Phis become copies on the incoming
+  //! edges. Constants and addresses are recomputed at each use.
+  //!
+  class ir_lowering {
+    cdk::basic_postfix_emitter &_pf;
+    const ir::function &_fn;
+    std::vector<bool> _reachable;
+    std::map<const ir::instruction*, int> _slots;       // frame offsets
+    std::map<long, int> _spills;                        // frame offsets of the register arguments (by ARG ival)
+    std::set<const ir::instruction*> _deferred;         // emitted at their use
+    std::map<const ir::instruction*, std::string> _data; // labels of literals
+    std::map<const ir::block*, std::string> _labels;
+    int _frame = 0;
+    int _lbl = 0;
+    int _line = 0;                                      // with -g, of the code emitted last
+    std::string _pgrecord, _pgfile;                     // with -pg (see pg)
+    int _pgframe = 0;
+
+  public:
+    ir_lowering(cdk::basic_postfix_emitter &pf, const ir::function &fn) :
+        _pf(pf), _fn(fn) {
+    }
+
+    /**
+     * With -pg, times the function in the given record (see pg_hooks) from
+     * its prologue to each RET; file, if not empty, is the label of the
+     * profile's name, which is written before returning (xpl).
+     */
+    void pg(const std::string &record, const std::string &file) {
+      _pgrecord = record;
+      _pgfile = file;
+    }
+
+    /** Emits the whole function (from its label to its last RET). */
+    void lower();
+
+  private:
+    std::string mklbl(int lbl);
+    const std::string &label(const ir::block *b);
+    static bool rematerialized(const ir::instruction *i);
+    static bool discarded(const ir::instruction *i);
+    static std::vector<ir::instruction*> pushed(const ir::instruction *i);
+    int defer(const std::vector<ir::instruction*> &code, const ir::instruction *user, int pos);
+    void allocate();
+    void value(const ir::instruction *i);
+    void compute(const ir::instruction *i);
+    void store(const ir::instruction *i);
+    bool copies(const ir::block *from, const ir::block *to, bool emit);
+    void emit(const ir::block *b, const ir::block *next);
+    void dispatch(const ir::instruction *scrutinee, const std::vector<std::pair<long, std::string>> &cases,
+                  const std::string &none);
+    void search(const ir::instruction *scrutinee, const std::vector<std::pair<long, std::string>> &cases,
+                size_t lo, size_t hi, const std::string &none);
+    void line(const ir::instruction *i);
+  };
+
+} // xpl
+
+#endif
@@ -0,0 +1,110 @@
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <sstream>
+#include <vector>
+#include "targets/ir_passes.h"
+
+//---------------------------------------------------------------------------
+
+namespace {
+
+  using namespace xpl::ir;
+
+  bool pure(const instruction *i) {
+    switch (i->code) {
+      case op::ICONST: case op::DCONST: case op::SCONST: case op::GLOBAL:
+      case op::ADD: case op::SUB: case op::MUL: case op::DIV: case op::MOD:
+      case op::NEG: case op::NOT: case op::I2D: case op::SHL: case op::SAR: case op::SHR: case op::MULHI:
+      case op::LT: case op::LE: case op::GT: case op::GE: case op::EQ: case op::NE:
+        return true;
+      default:
+        return false;
+    }
+  }
+
+  bool commutative(op code) {
+    return code == op::ADD || code == op::MUL || code == op::MULHI || code == op::EQ || code == op::NE;
+  }
+
+  // The value number of an operation: what it does and to which values.
+  std::string number(op code, type ty, std::vector<const instruction*> operands, const instruction *i) {
+    if (commutative(code))
+      std::sort(operands.begin(), operands.end(),
+                [](const instruction *a, const instruction *b) { return a->id < b->id; });
+    std::ostringstream key;
+    key << (int)code << ":" << (int)ty;
+    for (auto operand : operands)
+      key << " %" << operand->id;
+    if (i != nullptr) {
+      long long bits;
+      std::memcpy(&bits, &i->dval, sizeof bits);
+      key << " " << i->ival << " " << bits << " " << i->sval.size() << ":" << i->sval;
+    }
+    return key.str();
+  }
+
+  // What an address refers to: a global or a slot ("" for computed addresses, which may be anything).
+  std::string memory(const instruction *address) {
+    if (address->code == op::GLOBAL) return "global " + address->sval;
+    if (address->code == op::SLOT) return "slot " + std::to_string(address->id);
+    return "";
+  }
+
+}
+
+bool xpl::ir::lvn(function &fn) {
+  bool changed = false;
+  for (auto &b : fn.blocks) {
+    std::map<std::string, instruction*> values;
+    std::map<std::string, instruction*> loads;     // also the values just stored
+    std::map<std::string, std::string> where;      // memory read by each load
+
+    std::vector<instruction*> code = b->code;
+    for (auto i : code) {
+      if (i->code == op::CALL) {                   // callees may write anywhere
+        loads.clear();
+        where.clear();
+        continue;
+      }
+
+      if (i->code == op::STORE) {
+        instruction *address = i->operands[0], *value = i->operands[1];
+        std::string target = memory(address);
+        for (auto it = where.begin(); it != where.end();) {
+          if (target == "" || it->second == "" || it->second == target) {
+            loads.erase(it->first);
+            it = where.erase(it);
+          } else
+            ++it;
+        }
+        std::string key = number(op::LOAD, value->ty, { address }, nullptr);
+        loads[key] = value;
+        where[key] = target;
+        continue;
+      }
+
+      std::map<std::string, instruction*> *table;
+      std::string key;
+      if (pure(i)) {
+        table = &values;
+        key = number(i->code, i->ty, std::vector<const instruction*>(i->operands.begin(), i->operands.end()), i);
+      } else if (i->code == op::LOAD) {
+        table = &loads;
+        key = number(op::LOAD, i->ty, { i->operands[0] }, nullptr);
+      } else
+        continue;
+
+      auto known = table->find(key);
+      if (known == table->end()) {
+        (*table)[key] = i;
+        if (i->code == op::LOAD) where[key] = memory(i->operands[0]);
+        continue;
+      }
+      i->replace_uses(known->second);
+      fn.remove(i);
+      changed = true;
+    }
+  }
+  return changed;
+}
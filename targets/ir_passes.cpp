@@ -0,0 +1,13 @@
+#include "targets/ir_passes.h"
+
+//---------------------------------------------------------------------------
+
+void xpl::ir::optimize(function &fn, const library &callees, int budget) {
+  inline_calls(fn, callees);
+  tail_calls(fn);
+  lvn(fn);
+  licm(fn);
+  reduce(fn);
+  unroll(fn, budget);
+  dce(fn);
+}
@@ -0,0 +1,106 @@
+#ifndef __XPL_IR_PASSES_H__
+#define __XPL_IR_PASSES_H__
+
+#include <map>
+#include <memory>
+#include <string>
+#include "targets/ir.h"
+
+namespace xpl {
+  namespace ir {
+
+    //!
+    //! Optimization passes over the IR. Each one returns whether it changed
+    //! the function, which is left verifiable.
+    //!
+
+    /**
+     * Dead code elimination: removes the instructions whose values are not
+     * used and that have no effects, including phi cycles and stores to
+     * slots that are never read.
+     */
+    bool dce(function &fn);
+
+    /** Functions already optimized, by name, whose calls may be inlined. */
+    typedef std::map<std::string, std::unique_ptr<function>> library;
+
+    /**
+     * @return whether calls to fn may be replaced by its body: it is not
+     * public, does not call itself, does not allocate stack memory (that
+     * would only be freed when the caller returns) and costs no more than
+     * threshold instructions (constants, arguments and jumps are free).
+     */
+    bool inlinable(const function &fn, int threshold);
+
+    /**
+     * Inlining: replaces each call to a function in callees by a copy of
+     * its blocks, with the arguments as its parameters and its slots moved
+     * to the caller's frame.
+     */
+    bool inline_calls(function &fn, const library &callees);
+
+    /**
+     * Tail calls: a call of the function to itself whose value is returned
+     * right away becomes a jump back to the start, with the arguments as
+     * phis of a new loop header (the recursion then runs in constant stack).
+     * Functions with slots or stack allocation are left alone, since every
+     * call needs its own frame.
+     */
+    bool tail_calls(function &fn);
+
+    /**
+     * Local value numbering: in each block, a pure computation (or a load)
+     * that repeats one already made is replaced by it. Loads also reuse the
+     * value just stored to the same address. Stores forget the loads they
+     * may change (all of them, when the address is computed), and calls
+     * forget every load.
+     */
+    bool lvn(function &fn);
+
+    /**
+     * Loop-invariant code motion: moves to the loop's preheader the pure
+     * computations whose operands come from outside the loop. Only what
+     * cannot trap is moved (the loop may not run at all): integer division
+     * by constants other than 0 and -1, and loads of globals and slots that
+     * no store or call (read included) in the loop may change.
+     */
+    bool licm(function &fn);
+
+    /**
+     * Strength reduction: in loops, base + i * size (i an induction
+     * variable that moves by a constant step, base invariant) becomes a
+     * pointer that moves by step * size bytes with i; then, integer
+     * divisions by constants become multiplications and shifts, and
+     * multiplications by powers of two become shifts.
+     */
+    bool reduce(function &fn);
+
+    /**
+     * Loop unrolling: a loop that runs its body a known number of times
+     * (a sweep with constant bounds and step, for instance) is replaced by
+     * copies of its body, when they take no more than budget instructions.
+     * Otherwise, the copies (up to 8) make a loop whose test runs once for
+     * all of them, followed by the original loop for the iterations left.
+     */
+    bool unroll(function &fn, int budget);
+
+    /**
+     * Prints: the calls that print values and newlines, in a block with no
+     * other call between them, become one call of the runtime's
+     * __xpl_print (see print_format), where constant ints and strings are
+     * part of the format. A run ends at anything that may trap, so that
+     * what it printed before is not lost. Made before lowering, with -O or
+     * -fcoalesce-prints.
+     */
+    bool coalesce_prints(function &fn);
+
+    /**
+     * Runs the -O pipeline (callees are the functions that may be inlined,
+     * budget is the size that loop unrolling may add to each loop).
+     */
+    void optimize(function &fn, const library &callees = library(), int budget = 64);
+
+  } // ir
+} // xpl
+
+#endif
@@ -0,0 +1,97 @@
+#include <string>
+#include <vector>
+#include "targets/ir_passes.h"
+#include "targets/print_format.h"
+
+//---------------------------------------------------------------------------
+
+// Whether i is a call of the runtime that prints a value or a newline.
+static bool printing(const xpl::ir::instruction *i) {
+  return i->code == xpl::ir::op::CALL && i->ival == 0 &&
+         (i->sval == "printi" || i->sval == "printd" || i->sval == "prints" || i->sval == "println");
+}
+
+// Removes a constant the format took in, with what it was folded from
+// (see instruction::constant), when nothing else uses them.
+static void drop(xpl::ir::function &fn, xpl::ir::instruction *i) {
+  using namespace xpl::ir;
+  if (i->parent == nullptr || !i->users.empty()) return;
+  if (i->code != op::ICONST && i->code != op::SCONST && i->code != op::NEG && i->code != op::ADD &&
+      i->code != op::SUB && i->code != op::MUL)
+    return;
+  std::vector<instruction*> operands = i->operands;
+  fn.remove(i);
+  for (auto operand : operands)
+    drop(fn, operand);
+}
+
+// Whether i may trap (a division by zero or overflow, a bad address): the
+// prints before it must be made before it.
+static bool traps(const xpl::ir::instruction *i) {
+  using namespace xpl::ir;
+  long divisor;
+  switch (i->code) {
+    case op::DIV: case op::MOD:
+      return i->ty == type::INT && !(i->operands[1]->constant(divisor) && divisor != 0 && divisor != -1);
+    case op::LOAD: case op::STORE:
+      return i->operands[0]->code != op::SLOT && i->operands[0]->code != op::GLOBAL;
+    case op::ALLOC:
+      return true;
+    default:
+      return false;
+  }
+}
+
+// Replaces the calls (in one block, with no other call between them) by one
+// call of the format, just before the last of them.
+static void coalesce(xpl::ir::function &fn, const std::vector<xpl::ir::instruction*> &calls) {
+  using namespace xpl::ir;
+  xpl::print_format format;
+  std::vector<instruction*> values, constants;
+  for (auto call : calls) {
+    long value;
+    if (call->sval == "println") {
+      format.newline();
+    } else if (call->sval == "printi" && call->operands[0]->constant(value)) {
+      format.text(std::to_string(value));
+      constants.push_back(call->operands[0]);
+    } else if (call->sval == "prints" && call->operands[0]->code == op::SCONST) {
+      format.text(call->operands[0]->sval);
+      constants.push_back(call->operands[0]);
+    } else {
+      format.value(call->sval);
+      values.push_back(call->operands[0]);
+    }
+  }
+
+  instruction *text = fn.insert(calls.back(), op::SCONST, type::STRING);
+  text->sval = format.format();
+  instruction *print = fn.insert(calls.back(), op::CALL, type::VOID);
+  print->sval = format.values() > 0 ? xpl::print_format::printer() : "prints";
+  print->add(text);
+  for (auto value : values)
+    print->add(value);
+
+  for (auto call : calls)
+    fn.remove(call);
+  for (auto constant : constants)
+    drop(fn, constant);
+}
+
+bool xpl::ir::coalesce_prints(function &fn) {
+  bool changed = false;
+  for (auto &b : fn.blocks) {
+    std::vector<std::vector<instruction*>> runs(1);
+    for (auto i : b->code)
+      if (printing(i))
+        runs.back().push_back(i);
+      else if (i->code == op::CALL || traps(i))  // it may print (or read) too, or stop the program
+        runs.emplace_back();
+    for (auto &calls : runs)
+      if (calls.size() > 1) {
+        coalesce(fn, calls);
+        changed = true;
+      }
+  }
+  return changed;
+}
@@ -0,0 +1,206 @@
+#include <algorithm>
+#include <map>
+#include <vector>
+#include "targets/ir_passes.h"
+#include "targets/ir_loops.h"
+
+//---------------------------------------------------------------------------
+
+namespace {
+
+  using namespace xpl::ir;
+
+  // The other operand of a binary instruction with an int constant (nullptr if there is none).
+  instruction *by_constant(const instruction *i, long &value) {
+    for (size_t k = 0; k < 2; k++)
+      if (i->operands[k]->code == op::ICONST) {
+        value = i->operands[k]->ival;
+        return i->operands[1 - k];
+      }
+    return nullptr;
+  }
+
+  /**
+   * Replaces base + iv * size (base invariant, size constant) by a new
+   * pointer phi that starts at base + init * size and moves step * size
+   * bytes where the induction variable moves.
+   */
+  bool running_pointers(function &fn, const loop &l) {
+    block *pre = preheader(l);
+    if (pre == nullptr) return false;
+
+    std::map<instruction*, induction> ivs;
+    for (auto i : l.header->code) {
+      if (i->code != op::PHI) break;
+      induction iv;
+      if (i->ty == type::INT && basic(i, l, pre, iv)) ivs[i] = iv;
+    }
+    if (ivs.empty()) return false;
+
+    std::vector<instruction*> candidates;
+    for (auto id : l.body)
+      for (auto i : fn.blocks[id]->code)
+        if (i->code == op::ADD && i->ty == type::POINTER) candidates.push_back(i);
+
+    bool changed = false;
+    for (auto p : candidates) {
+      for (size_t k = 0; k < 2; k++) {
+        instruction *base = p->operands[k], *scaled = p->operands[1 - k];
+        long size;
+        if (l.contains(base) || scaled->code != op::MUL) continue;
+        instruction *v = by_constant(scaled, size);
+        if (v == nullptr || ivs.count(v) == 0) continue;
+        const induction &iv = ivs[v];
+
+        instruction *init = nullptr;
+        for (size_t j = 0; j < v->operands.size(); j++)
+          if (v->targets[j] == pre) init = v->operands[j];
+
+        instruction *at = pre->terminator();
+        instruction *bytes = fn.insert(at, op::ICONST, type::INT);
+        bytes->ival = size;
+        instruction *offset = fn.insert(at, op::MUL, type::INT);
+        offset->add(init);
+        offset->add(bytes);
+        instruction *start = fn.insert(at, op::ADD, type::POINTER);
+        start->add(base);
+        start->add(offset);
+
+        block *b = iv.next->parent;
+        at = b->code[std::find(b->code.begin(), b->code.end(), iv.next) - b->code.begin() + 1];
+        instruction *phi = fn.make(l.header, op::PHI, type::POINTER);
+        instruction *stride = fn.insert(at, op::ICONST, type::INT);
+        stride->ival = iv.step * size;
+        instruction *next = fn.insert(at, op::ADD, type::POINTER);
+        next->add(phi);
+        next->add(stride);
+        for (size_t j = 0; j < v->operands.size(); j++) {
+          phi->add(v->targets[j] == pre ? start : next);
+          phi->targets.push_back(v->targets[j]);
+        }
+
+        p->replace_uses(phi);
+        fn.remove(p);
+        changed = true;
+        break;
+      }
+    }
+    return changed;
+  }
+
+  // The shift that multiplies by value (-1 if it is not a power of two).
+  int shift(long value) {
+    for (int bits = 1; bits < 31; bits++)
+      if (value == 1L << bits) return bits;
+    return -1;
+  }
+
+  /**
+   * Magic number and shift for signed division by d (|d| > 1, not a power
+   * of two): x / d is mulhi(x, m) (+ x if d > 0 and m < 0, - x if d < 0 and
+   * m > 0), shifted right by s, plus its sign bit. From Warren, "Hacker's
+   * Delight", 10-4.
+   */
+  void magic(int d, int &m, int &s) {
+    const unsigned two31 = 0x80000000u;
+    unsigned ad = d < 0 ? -(unsigned)d : d;
+    unsigned t = two31 + ((unsigned)d >> 31);
+    unsigned anc = t - 1 - t % ad;
+    unsigned q1 = two31 / anc, r1 = two31 - q1 * anc;
+    unsigned q2 = two31 / ad, r2 = two31 - q2 * ad;
+    unsigned delta;
+    int p = 31;
+    do {
+      p++;
+      q1 *= 2; r1 *= 2;
+      if (r1 >= anc) { q1++; r1 -= anc; }
+      q2 *= 2; r2 *= 2;
+      if (r2 >= ad) { q2++; r2 -= ad; }
+      delta = ad - r2;
+    } while (q1 < delta || (q1 == delta && r1 == 0));
+    m = (int)(q2 + 1);
+    if (d < 0) m = -m;
+    s = p - 32;
+  }
+
+  instruction *binary(function &fn, instruction *at, op code, instruction *a, instruction *b) {
+    instruction *i = fn.insert(at, code, type::INT);
+    i->add(a);
+    i->add(b);
+    return i;
+  }
+
+  instruction *constant(function &fn, instruction *at, long value) {
+    instruction *i = fn.insert(at, op::ICONST, type::INT);
+    i->ival = value;
+    return i;
+  }
+
+  /**
+   * The quotient of x by the constant d (not 0 or -1), truncated towards
+   * zero like idiv, computed before at with shifts and a multiplication.
+   */
+  instruction *quotient(function &fn, instruction *at, instruction *x, int d) {
+    if (d == 1) return x;
+    int bits = shift(d < 0 ? -d : d);
+    if (bits < 0) {
+      int m, s;
+      magic(d, m, s);
+      instruction *q = binary(fn, at, op::MULHI, x, constant(fn, at, m));
+      if (d > 0 && m < 0) q = binary(fn, at, op::ADD, q, x);
+      if (d < 0 && m > 0) q = binary(fn, at, op::SUB, q, x);
+      if (s > 0) q = binary(fn, at, op::SAR, q, constant(fn, at, s));
+      return binary(fn, at, op::ADD, q, binary(fn, at, op::SHR, q, constant(fn, at, 31)));
+    }
+
+    // negative dividends are biased by |d| - 1, so that the shift rounds towards zero
+    instruction *sign = binary(fn, at, op::SAR, x, constant(fn, at, 31));
+    instruction *bias = binary(fn, at, op::SHR, sign, constant(fn, at, 32 - bits));
+    instruction *q = binary(fn, at, op::SAR, binary(fn, at, op::ADD, x, bias), constant(fn, at, bits));
+    if (d > 0) return q;
+    instruction *neg = fn.insert(at, op::NEG, type::INT);
+    neg->add(q);
+    return neg;
+  }
+
+}
+
+bool xpl::ir::reduce(function &fn) {
+  bool changed = false;
+  preheaders(fn);
+  for (auto &l : loops(fn))
+    changed |= running_pointers(fn, l);
+
+  // integer divisions by constants are multiplications and shifts (x % d is x - x / d * d)
+  std::vector<instruction*> divs;
+  for (auto &b : fn.blocks)
+    for (auto i : b->code)
+      if ((i->code == op::DIV || i->code == op::MOD) && i->ty == type::INT) divs.push_back(i);
+  for (auto div : divs) {
+    long d;
+    if (!div->operands[1]->constant(d) || d == 0 || d == -1 || d != (int)d || d == -2147483648L) continue;  // left to idiv (and its traps)
+    instruction *x = div->operands[0];
+    instruction *q = quotient(fn, div, x, d);
+    if (div->code == op::MOD)
+      q = binary(fn, div, op::SUB, x, binary(fn, div, op::MUL, q, constant(fn, div, d)));
+    div->replace_uses(q);
+    fn.remove(div);
+    changed = true;
+  }
+
+  // multiplications by powers of two are shifts
+  std::vector<instruction*> muls;
+  for (auto &b : fn.blocks)
+    for (auto i : b->code)
+      if (i->code == op::MUL && i->ty == type::INT) muls.push_back(i);
+  for (auto mul : muls) {
+    long value;
+    instruction *x = by_constant(mul, value);
+    int bits = x == nullptr ? -1 : shift(value);
+    if (bits < 0) continue;
+    mul->replace_uses(binary(fn, mul, op::SHL, x, constant(fn, mul, bits)));
+    fn.remove(mul);
+    changed = true;
+  }
+  return changed;
+}
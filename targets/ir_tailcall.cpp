@@ -0,0 +1,110 @@
+#include <algorithm>
+#include <map>
+#include <vector>
+#include "targets/ir_passes.h"
+
+//---------------------------------------------------------------------------
+
+/**
+ * Whether call (a call to fn itself) is in tail position: nothing follows
+ * it in its block, and the jumps from there (through blocks with nothing
+ * but phis and a jump) reach a ret of the call's value.
+ */
+static bool tail(const xpl::ir::function &fn, const xpl::ir::instruction *call) {
+  using namespace xpl::ir;
+  const block *b = call->parent;
+  const instruction *value = call;
+  if (b->code.size() < 2 || b->code[b->code.size() - 2] != call) return false;
+  for (size_t steps = 0; steps < fn.blocks.size(); steps++) {
+    const instruction *t = b->terminator();
+    if (t->code == op::RET)
+      return t->operands.empty() ? !call->has_value() : t->operands[0] == value;
+    if (t->code != op::JMP) return false;
+    const block *next = t->targets[0];
+    for (auto i : next->code) {
+      if (i->terminator()) break;
+      if (i->code != op::PHI) return false;
+      for (size_t k = 0; k < i->operands.size(); k++)
+        if (i->targets[k] == b && i->operands[k] == value) {
+          value = i;
+          break;
+        }
+    }
+    b = next;
+  }
+  return false;
+}
+
+bool xpl::ir::tail_calls(function &fn) {
+  block *entry = fn.blocks[0].get();
+  if (!entry->preds.empty()) return false;
+  for (auto &b : fn.blocks)
+    for (auto i : b->code)
+      if (i->code == op::SLOT || i->code == op::ALLOC) return false; // frames must not be shared
+
+  std::vector<instruction*> calls;
+  for (auto &b : fn.blocks)
+    for (auto i : b->code)
+      if (i->code == op::CALL && i->sval == fn.name && tail(fn, i)) calls.push_back(i);
+  if (calls.empty()) return false;
+
+  // the entry keeps the arguments; everything else goes to a new loop header
+  block *header = fn.make_block();
+  std::vector<instruction*> args;
+  for (auto i : entry->code) {
+    if (i->code == op::ARG) {
+      args.push_back(i);
+    } else {
+      i->parent = header;
+      header->code.push_back(i);
+    }
+  }
+  entry->code = args;
+  for (auto s : header->succs()) {
+    std::replace(s->preds.begin(), s->preds.end(), entry, header);
+    for (auto phi : s->code) {
+      if (phi->code != op::PHI) break;
+      std::replace(phi->targets.begin(), phi->targets.end(), entry, header);
+    }
+  }
+  fn.make(entry, op::JMP, type::VOID)->targets.push_back(header);
+  header->preds.push_back(entry);
+
+  // each argument is a phi of its value on entry and the values of the tail calls
+  std::map<long, instruction*> phis;
+  for (auto arg : args) {
+    instruction *phi = fn.make(header, op::PHI, arg->ty);
+    arg->replace_uses(phi);
+    phi->add(arg);
+    phi->targets.push_back(entry);
+    phis[arg->ival] = phi;
+  }
+
+  for (auto call : calls) {
+    block *b = call->parent;
+    instruction *exit = b->terminator();  // jmp (towards the ret) or ret
+    if (exit->code == op::JMP) fn.disconnect(b, exit->targets[0]);
+
+    std::vector<long> at = places(call);
+    for (size_t k = 0; k < at.size(); k++) {
+      auto phi = phis.find(at[k]);
+      if (phi != phis.end()) {
+        phi->second->add(call->operands[k]);
+        phi->second->targets.push_back(b);
+      }
+    }
+    fn.remove(exit);
+    fn.remove(call);
+    fn.make(b, op::JMP, type::VOID)->targets.push_back(header);
+    header->preds.push_back(b);
+  }
+
+  // the header follows the entry
+  std::unique_ptr<block> moved = std::move(fn.blocks.back());
+  fn.blocks.pop_back();
+  fn.blocks.insert(fn.blocks.begin() + 1, std::move(moved));
+  for (size_t k = 0; k < fn.blocks.size(); k++)
+    fn.blocks[k]->id = k;
+  fn.prune();
+  return true;
+}
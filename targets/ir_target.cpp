@@ -0,0 +1,4 @@
+#include "targets/ir_target.h"
+
+/** @var create and register the IR target (SSA form of each function). */
+xpl::ir_target xpl::ir_target::_self;
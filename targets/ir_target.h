@@ -0,0 +1,50 @@
+#ifndef __XPL_SEMANTICS_IR_TARGET_H__
+#define __XPL_SEMANTICS_IR_TARGET_H__
+
+#include <cstdlib>
+#include <set>
+#include <string>
+#include <cdk/basic_target.h>
+#include <cdk/symbol_table.h>
+#include <cdk/ast/basic_node.h>
+#include <cdk/compiler.h>
+#include "targets/ir_builder.h"
+#include "targets/ir_passes.h"
+#include "targets/symbol.h"
+
+namespace xpl {
+
+  class ir_target: public cdk::basic_target {
+    static ir_target _self;
+
+  private:
+    inline ir_target() :
+        cdk::basic_target("ir") {
+    }
+
+  public:
+    bool evaluate(std::shared_ptr<cdk::compiler> compiler) {
+      cdk::symbol_table<xpl::symbol> symtab;
+      std::set<std::string> imports, defined;
+
+      // build (and verify) the SSA form of every function, then print it (optimized, with -O)
+      ir_builder builder(compiler, symtab, imports, defined);
+      compiler->ast()->accept(&builder, 0);
+      ir::library inlinable;
+      int threshold = std::atoi(compiler->flag("inline-threshold", "16").c_str());
+      int budget = std::atoi(compiler->flag("unroll-budget", "64").c_str());
+      for (auto &fn : builder.functions()) {
+        if (compiler->optimize()) ir::optimize(*fn, inlinable, budget);
+        fn->print(*compiler->ostream());
+        if (compiler->optimize() && ir::inlinable(*fn, threshold))
+          inlinable[fn->name] = std::move(fn);
+      }
+
+      return compiler->errors() == 0;
+    }
+
+  };
+
+} // xpl
+
+#endif
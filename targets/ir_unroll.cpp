@@ -0,0 +1,345 @@
+#include <algorithm>
+#include <climits>
+#include <map>
+#include <vector>
+#include "targets/ir_passes.h"
+#include "targets/ir_loops.h"
+
+//---------------------------------------------------------------------------
+
+namespace {
+
+  using namespace xpl::ir;
+
+  // Beyond this many copies in a loop, the jumps saved no longer pay for the code.
+  const long max_factor = 8;
+
+  /**
+   * A loop whose body runs a known number of times: the header's test is
+   * the only way out (to exit), and otherwise enters the body at first;
+   * the test compares a basic induction variable, which starts at init,
+   * with a constant.
+   */
+  struct counted {
+    block *pre, *first, *exit;
+    std::vector<block*> latches;
+    induction iv;
+    long init, trips;
+  };
+
+  // The times "v code limit" holds while v moves from init by step (false if unknown, or if v would wrap around).
+  bool trips(op code, long long init, long long limit, long long step, long &count) {
+    long long n;
+    if (step == 0) return false;
+    switch (code) {
+      case op::LT: n = init >= limit ? 0 : step < 0 ? -1 : (limit - init + step - 1) / step; break;
+      case op::LE: n = init > limit ? 0 : step < 0 ? -1 : (limit - init) / step + 1; break;
+      case op::GT: n = init <= limit ? 0 : step > 0 ? -1 : (init - limit - step - 1) / -step; break;
+      case op::GE: n = init < limit ? 0 : step > 0 ? -1 : (init - limit) / -step + 1; break;
+      default: return false;
+    }
+    long long last = init + n * step;
+    if (n < 0 || last < INT_MIN || last > INT_MAX) return false;
+    count = n;
+    return true;
+  }
+
+  // The comparison with its operands swapped (swapped) or its result negated.
+  op mirror(op code, bool swapped) {
+    switch (code) {
+      case op::LT: return swapped ? op::GT : op::GE;
+      case op::LE: return swapped ? op::GE : op::GT;
+      case op::GT: return swapped ? op::LT : op::LE;
+      case op::GE: return swapped ? op::LE : op::LT;
+      default: return code;
+    }
+  }
+
+  bool analyze(const function &fn, const loop &l, counted &c) {
+    block *h = l.header;
+    c.pre = preheader(l);
+    instruction *br = h->terminator();
+    if (c.pre == nullptr || br == nullptr || br->code != op::BR) return false;
+    bool inside = l.body.count(br->targets[0]->id) > 0;
+    if (inside == (l.body.count(br->targets[1]->id) > 0)) return false;
+    c.first = br->targets[inside ? 0 : 1];
+    c.exit = br->targets[inside ? 1 : 0];
+    if (c.first == h) return false;
+
+    c.latches.clear();
+    for (auto id : l.body) {
+      block *b = fn.blocks[id].get();
+      for (auto s : b->succs()) {
+        if (b != h && l.body.count(s->id) == 0) return false;   // stop, or another way out
+        if (s == h) c.latches.push_back(b);
+      }
+    }
+    // the header is copied, test included, and may run once more when leaving the unrolled loop
+    for (auto i : h->code)
+      if (i->code == op::CALL || i->code == op::STORE || i->code == op::ALLOC) return false;
+
+    instruction *cond = br->operands[0];
+    if (cond->code != op::LT && cond->code != op::LE && cond->code != op::GT && cond->code != op::GE) return false;
+    op code = cond->code;
+    instruction *v = cond->operands[0];
+    long limit;
+    if (!cond->operands[1]->constant(limit)) {
+      v = cond->operands[1];
+      if (!cond->operands[0]->constant(limit)) return false;
+      code = mirror(code, true);
+    }
+    if (!inside) code = mirror(code, false);
+    if (v->code != op::PHI || v->parent != h || v->ty != type::INT || !basic(v, l, c.pre, c.iv)) return false;
+    for (size_t k = 0; k < v->operands.size(); k++)
+      if (v->targets[k] == c.pre && !v->operands[k]->constant(c.init)) return false;
+    return trips(code, c.init, limit, c.iv.step, c.trips) && c.trips > 0;
+  }
+
+  // The instructions of the loop that cost something (constants and addresses fold into their uses).
+  long cost(const function &fn, const loop &l) {
+    long n = 0;
+    for (auto id : l.body)
+      for (auto i : fn.blocks[id]->code)
+        switch (i->code) {
+          case op::ICONST: case op::DCONST: case op::SCONST: case op::UNDEF:
+          case op::ARG: case op::GLOBAL: case op::SLOT: case op::PHI:
+            break;
+          default:
+            n++;
+        }
+    return n;
+  }
+
+  // A copy of the loop's blocks, and of the values computed there.
+  struct copy {
+    std::map<const block*, block*> blocks;
+    std::map<const instruction*, instruction*> values;
+
+    instruction *value(instruction *i) const {
+      auto it = values.find(i);
+      return it == values.end() ? i : it->second;
+    }
+  };
+
+  /**
+   * Copies the loop's blocks to new blocks (at the end of the function).
+   * Header phis already in c.values are not copied, and the others are
+   * copied without operands, for the caller to fill. Back edges still go
+   * to the original header, and the copy of the header's test is left for
+   * the caller to replace.
+   */
+  copy clone(function &fn, const loop &l, copy c) {
+    for (auto id : l.body)
+      c.blocks[fn.blocks[id].get()] = fn.make_block();
+
+    std::vector<std::pair<const instruction*, instruction*>> copied;
+    for (auto id : l.body) {
+      const block *b = fn.blocks[id].get();
+      block *to = c.blocks[b];
+      if (b != l.header)
+        for (auto p : b->preds)
+          to->preds.push_back(c.blocks[p]);
+      std::vector<instruction*> code;
+      for (auto i : b->code) {
+        if (c.values.count(i)) continue;
+        instruction *x = fn.make(to, i->code, i->ty);
+        x->ival = i->ival;
+        x->dval = i->dval;
+        x->sval = i->sval;
+        x->line = i->line;
+        if (i->code != op::PHI || b != l.header)
+          for (auto t : i->targets)
+            x->targets.push_back(t == l.header || c.blocks.count(t) == 0 ? t : c.blocks[t]);
+        c.values[i] = x;
+        copied.push_back(std::make_pair(i, x));
+        code.push_back(x);
+      }
+      to->code = code;   // phis were made at the front
+    }
+    for (auto &p : copied) {
+      if (p.first->code == op::PHI && p.first->parent == l.header) continue;
+      for (auto operand : p.first->operands)
+        p.second->add(c.value(operand));
+    }
+    return c;
+  }
+
+  // Sends the back edges of a copy to block to.
+  void link(const copy &c, const loop &l, const counted &k, block *to) {
+    for (auto latch : k.latches) {
+      block *b = c.blocks.at(latch);
+      std::vector<block*> &targets = b->terminator()->targets;
+      std::replace(targets.begin(), targets.end(), l.header, to);
+      to->preds.push_back(b);
+    }
+  }
+
+  // Gives phi (made for the header phi original) the values that come from the back edges of c.
+  void feed(instruction *phi, const instruction *original, const copy &c, const counted &k) {
+    for (size_t j = 0; j < original->operands.size(); j++) {
+      if (original->targets[j] == k.pre) continue;
+      phi->add(c.value(original->operands[j]));
+      phi->targets.push_back(c.blocks.at(original->targets[j]));
+    }
+  }
+
+  // The value that comes from all the back edges of c to phi (nullptr if they differ).
+  instruction *common(const instruction *phi, const copy &c, const counted &k) {
+    instruction *value = nullptr;
+    for (size_t j = 0; j < phi->operands.size(); j++) {
+      if (phi->targets[j] == k.pre) continue;
+      if (value != nullptr && c.value(phi->operands[j]) != value) return nullptr;
+      value = c.value(phi->operands[j]);
+    }
+    return value;
+  }
+
+  instruction *entry_value(const instruction *phi, const counted &k) {
+    for (size_t j = 0; j < phi->operands.size(); j++)
+      if (phi->targets[j] == k.pre) return phi->operands[j];
+    return nullptr;
+  }
+
+  instruction *constant(function &fn, block *b, long value) {
+    instruction *i = fn.insert(b->terminator(), op::ICONST, type::INT);
+    i->ival = value;
+    return i;
+  }
+
+  /**
+   * Makes factor copies of the loop, one after the other, before its
+   * header. Each copy's header (but the first, when partial) jumps
+   * straight to its body, and its back edges go to the next copy. A full
+   * unroll (factor is the trip count) leaves the original header to pass
+   * the final values to the exit; otherwise, the copies are a loop that
+   * runs while the trip count left is at least factor, and the original
+   * loop runs the remaining iterations.
+   */
+  void expand(function &fn, const loop &l, const counted &k, long factor) {
+    bool full = factor == k.trips;
+    block *h = l.header;
+    std::vector<copy> copies;
+    for (long j = 0; j < factor; j++) {
+      copy c;
+      for (auto phi : h->code) {
+        if (phi->code != op::PHI) break;
+        if (full && phi == k.iv.phi)
+          c.values[phi] = constant(fn, k.pre, k.init + j * k.iv.step);
+        else if (full && j == 0)
+          c.values[phi] = entry_value(phi, k);
+        else if (j > 0 && common(phi, copies.back(), k) != nullptr)
+          c.values[phi] = common(phi, copies.back(), k);
+      }
+      copies.push_back(clone(fn, l, c));
+      if (j > 0) {
+        for (auto phi : h->code) {
+          if (phi->code != op::PHI) break;
+          instruction *x = copies[j].values[phi];
+          if (x->parent == copies[j].blocks.at(h)) feed(x, phi, copies[j - 1], k);
+        }
+        link(copies[j - 1], l, k, copies[j].blocks.at(h));
+      }
+    }
+
+    // the copies' headers go straight to their bodies (but the first, when partial)
+    for (long j = full ? 0 : 1; j < factor; j++) {
+      block *b = copies[j].blocks.at(h);
+      fn.remove(b->terminator());
+      fn.make(b, op::JMP, type::VOID)->targets.push_back(copies[j].blocks.at(k.first));
+    }
+
+    // enter the copies
+    block *top = copies[0].blocks.at(h);
+    std::vector<block*> &targets = k.pre->terminator()->targets;
+    std::replace(targets.begin(), targets.end(), h, top);
+    top->preds.push_back(k.pre);
+
+    if (full) {
+      // the original header takes the last values, and leaves
+      h->preds.erase(std::find(h->preds.begin(), h->preds.end(), k.pre));
+      link(copies.back(), l, k, h);
+      std::map<instruction*, instruction*> last;   // made before replacing: phis may use each other
+      std::vector<instruction*> code = h->code;
+      for (auto phi : code) {
+        if (phi->code != op::PHI) break;
+        if (phi == k.iv.phi) {
+          last[phi] = constant(fn, k.pre, k.init + k.trips * k.iv.step);
+        } else if (common(phi, copies.back(), k) != nullptr) {
+          last[phi] = common(phi, copies.back(), k);
+        } else {
+          last[phi] = fn.make(h, op::PHI, phi->ty);
+          feed(last[phi], phi, copies.back(), k);
+        }
+      }
+      for (auto &p : last) {
+        p.first->replace_uses(p.second);
+        fn.remove(p.first);
+      }
+      fn.remove(h->terminator());
+      fn.make(h, op::JMP, type::VOID)->targets.push_back(k.exit);
+      fn.disconnect(h, k.first);
+    } else {
+      // the copies loop while a whole round is left; then, the original loop does the rest
+      for (auto phi : h->code) {
+        if (phi->code != op::PHI) break;
+        instruction *x = copies[0].values[phi];
+        x->add(entry_value(phi, k));
+        x->targets.push_back(k.pre);
+        feed(x, phi, copies.back(), k);
+      }
+      link(copies.back(), l, k, top);
+      long rounds = k.trips / factor;
+      instruction *stop = constant(fn, top, k.init + rounds * factor * k.iv.step);
+      instruction *more = fn.insert(top->terminator(), op::NE, type::INT);
+      more->add(copies[0].values[k.iv.phi]);
+      more->add(stop);
+      fn.remove(top->terminator());
+      instruction *br = fn.make(top, op::BR, type::VOID);
+      br->add(more);
+      br->targets.push_back(copies[0].blocks.at(k.first));
+      br->targets.push_back(h);
+
+      fn.disconnect(k.pre, h);
+      h->preds.push_back(top);
+      for (auto phi : h->code) {
+        if (phi->code != op::PHI) break;
+        phi->add(copies[0].values[phi]);
+        phi->targets.push_back(top);
+      }
+    }
+
+    // lay the copies out just before the original header
+    size_t first = fn.blocks.size() - factor * l.body.size();
+    std::vector<std::unique_ptr<block>> order;
+    for (size_t j = 0; j < first; j++) {
+      if (fn.blocks[j].get() == h)
+        for (size_t m = first; m < fn.blocks.size(); m++)
+          order.push_back(std::move(fn.blocks[m]));
+      order.push_back(std::move(fn.blocks[j]));
+    }
+    fn.blocks.swap(order);
+    for (size_t j = 0; j < fn.blocks.size(); j++)
+      fn.blocks[j]->id = j;
+    fn.straighten();   // the copies' headers and bodies, mostly
+  }
+
+}
+
+bool xpl::ir::unroll(function &fn, int budget) {
+  bool changed = false;
+  preheaders(fn);
+  for (bool again = true; again;) {
+    again = false;
+    for (auto &l : loops(fn)) {
+      counted k;
+      if (!analyze(fn, l, k)) continue;
+      long size = cost(fn, l);
+      long factor = k.trips * size <= budget ? k.trips : std::min(budget / size, max_factor);
+      if (factor < 2 && factor != k.trips) continue;
+      expand(fn, l, k, factor);
+      changed = again = true;
+      break;   // the loops are renumbered
+    }
+  }
+  return changed;
+}
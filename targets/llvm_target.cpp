@@ -0,0 +1,4 @@
+#include "targets/llvm_target.h"
+
+/** @var create and register the LLVM target (the program as an LLVM module, in a .ll file). */
+xpl::llvm_target xpl::llvm_target::_self;
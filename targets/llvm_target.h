@@ -0,0 +1,48 @@
+#ifndef __XPL_SEMANTICS_LLVM_TARGET_H__
+#define __XPL_SEMANTICS_LLVM_TARGET_H__
+
+#include <set>
+#include <string>
+#include <cdk/basic_target.h>
+#include <cdk/symbol_table.h>
+#include <cdk/ast/basic_node.h>
+#include <cdk/ast/sequence_node.h>
+#include <cdk/compiler.h>
+#include "targets/ir_builder.h"
+#include "targets/llvm_writer.h"
+#include "targets/symbol.h"
+
+namespace xpl {
+
+  class llvm_target: public cdk::basic_target {
+    static llvm_target _self;
+
+  private:
+    inline llvm_target() :
+        cdk::basic_target("ll") {
+    }
+
+  public:
+    bool evaluate(std::shared_ptr<cdk::compiler> compiler) {
+      cdk::symbol_table<xpl::symbol> symtab;
+      std::set<std::string> imports, defined;
+
+      // the declarations first: building frees the types of the arguments (with their symbols)
+      llvm_writer writer(compiler, dynamic_cast<cdk::sequence_node*>(compiler->ast()));
+
+      // build (and verify) the SSA form of every function; optimizing it is left to opt
+      ir_builder builder(compiler, symtab, imports, defined);
+      compiler->ast()->accept(&builder, 0);
+      if (compiler->errors() != 0) return false;
+      for (auto &fn : builder.functions())
+        writer.function(*fn);
+      writer.finish();
+
+      return compiler->errors() == 0;
+    }
+
+  };
+
+} // xpl
+
+#endif
@@ -0,0 +1,437 @@
+#include <cstdint>
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+#include "targets/llvm_writer.h"
+#include "ast/all.h"  // all.h is automatically generated
+
+//---------------------------------------------------------------------------
+
+static xpl::ir::type irtype(basic_type *type) {
+  if (type == nullptr) return xpl::ir::type::VOID;
+  switch (type->name()) {
+    case basic_type::TYPE_INT:     return xpl::ir::type::INT;
+    case basic_type::TYPE_DOUBLE:  return xpl::ir::type::REAL;
+    case basic_type::TYPE_STRING:  return xpl::ir::type::STRING;
+    case basic_type::TYPE_POINTER: return xpl::ir::type::POINTER;
+    default:                       return xpl::ir::type::VOID;
+  }
+}
+
+// reals are written by their bits: LLVM only takes decimals that are exact
+static std::string hex(double value) {
+  uint64_t bits;
+  std::memcpy(&bits, &value, sizeof bits);
+  std::ostringstream oss;
+  oss << "0x" << std::hex << std::uppercase << std::setw(16) << std::setfill('0') << bits;
+  return oss.str();
+}
+
+static std::string parameters(const std::vector<xpl::ir::type> &params, bool named) {
+  std::ostringstream oss;
+  for (size_t k = 0; k < params.size(); k++) {
+    if (k > 0) oss << ", ";
+    oss << xpl::llvm_writer::type(params[k]);
+    if (named) oss << " %a" << k;
+  }
+  return oss.str();
+}
+
+//---------------------------------------------------------------------------
+
+xpl::llvm_writer::llvm_writer(std::shared_ptr<cdk::compiler> compiler, cdk::sequence_node * const program) :
+    _compiler(compiler), _os(*compiler->ostream()) {
+  _signatures["printi"] = { ir::type::VOID, { ir::type::INT } };
+  _signatures["printd"] = { ir::type::VOID, { ir::type::REAL } };
+  _signatures["prints"] = { ir::type::VOID, { ir::type::STRING } };
+  _signatures["println"] = { ir::type::VOID, {} };
+  _signatures["readi"] = { ir::type::INT, {} };
+  _signatures["readd"] = { ir::type::REAL, {} };
+
+  const std::string &source = compiler->ifile();
+  _os << "; ModuleID = '" << source << "'" << std::endl;
+  _os << "source_filename = \"" << source << "\"" << std::endl;
+  // 32 bit code, for the RTS and because addresses are ints (llc takes the target from here)
+  _os << "target datalayout = \"e-m:e-p:32:32-p270:32:32-p271:32:32-p272:64:64-f64:32:64-f80:32-n8:16:32-S128\""
+      << std::endl;
+  _os << "target triple = \"i386-pc-linux-gnu\"" << std::endl << std::endl;
+
+  for (size_t i = 0; program != nullptr && i < program->size(); i++) {
+    signature sig;
+    cdk::sequence_node *args = nullptr;
+    if (auto fn = dynamic_cast<xpl::function_node*>(program->node(i))) {
+      sig.ret = irtype(fn->type());
+      args = fn->argument();
+      _defined.insert(callee(*fn->name()));
+      if (_signatures.count(callee(*fn->name()))) continue;
+      for (size_t k = 0; args != nullptr && k < args->size(); k++)
+        if (auto decl = dynamic_cast<xpl::decl_variable_node*>(args->node(k)))
+          sig.params.push_back(irtype(decl->type()));
+      _signatures[callee(*fn->name())] = sig;
+    } else if (auto fn = dynamic_cast<xpl::decl_function_node*>(program->node(i))) {
+      sig.ret = irtype(fn->type());
+      args = fn->argument();
+      for (size_t k = 0; args != nullptr && k < args->size(); k++)
+        if (auto decl = dynamic_cast<xpl::decl_variable_node*>(args->node(k)))
+          sig.params.push_back(irtype(decl->type()));
+      _signatures[callee(*fn->name())] = sig;
+    } else if (auto var = dynamic_cast<xpl::decl_variable_node*>(program->node(i))) {
+      // globals: initialized with a literal (as in the native code), or zero
+      const std::string &id = *var->name();
+      ir::type ty = irtype(var->type());
+      std::string value = ty == ir::type::INT ? "0" : ty == ir::type::REAL ? hex(0) : "null";
+      if (auto literal = dynamic_cast<cdk::integer_node*>(var->init())) {
+        if (ty == ir::type::REAL)
+          value = hex(literal->value());
+        else if (ty != ir::type::INT && literal->value() != 0)
+          value = "inttoptr (i32 " + std::to_string(literal->value()) + " to i8*)";
+        else if (ty == ir::type::INT)
+          value = std::to_string(literal->value());
+      } else if (auto literal = dynamic_cast<cdk::double_node*>(var->init())) {
+        value = hex(literal->value());
+      } else if (auto literal = dynamic_cast<cdk::string_node*>(var->init())) {
+        value = string(literal->value());
+      } else if (var->init() != nullptr) {
+        _compiler->error(var->lineno(), "A global variable can only be initialized with a literal");
+        continue;
+      }
+
+      _globals[id] = type(ty);
+      _os << "@" << id << " = ";
+      if (var->toImport())
+        _os << "external global " << type(ty) << std::endl;
+      else
+        _os << (var->toExport() ? "" : "internal ") << "global " << type(ty) << " " << value << std::endl;
+    }
+  }
+}
+
+std::string xpl::llvm_writer::callee(const std::string &id) {
+  return id == "xpl" ? "_main" : id == "_main" ? "._main" : id;
+}
+
+const char *xpl::llvm_writer::type(ir::type ty) {
+  switch (ty) {
+    case ir::type::INT:     return "i32";
+    case ir::type::REAL:    return "double";
+    case ir::type::STRING:
+    case ir::type::POINTER: return "i8*";
+    default:                return "void";
+  }
+}
+
+// The address of a literal's first character (a constant expression).
+std::string xpl::llvm_writer::string(const std::string &text) {
+  std::string &name = _strings[text];
+  if (name == "") name = "@.str." + std::to_string(_strings.size() - 1);
+  std::string array = "[" + std::to_string(text.size() + 1) + " x i8]";
+  return "getelementptr inbounds (" + array + ", " + array + "* " + name + ", i32 0, i32 0)";
+}
+
+// The address of a variable (a constant expression).
+std::string xpl::llvm_writer::global(const std::string &name) {
+  auto it = _globals.find(name);
+  if (it == _globals.end()) {
+    _unknown.insert(name);
+    return "@" + name;
+  }
+  return "bitcast (" + it->second + "* @" + name + " to i8*)";
+}
+
+bool xpl::llvm_writer::constant(const ir::instruction *i) const {
+  switch (i->code) {
+    case ir::op::ICONST: case ir::op::DCONST: case ir::op::SCONST:
+    case ir::op::UNDEF: case ir::op::GLOBAL:
+      return true;
+    default:
+      return false;
+  }
+}
+
+std::string xpl::llvm_writer::ref(const ir::instruction *i) {
+  switch (i->code) {
+    case ir::op::ICONST: return std::to_string(i->ival);
+    case ir::op::DCONST: return hex(i->dval);
+    case ir::op::SCONST: return string(i->sval);
+    case ir::op::UNDEF:  return "undef";
+    case ir::op::GLOBAL: return global(i->sval);
+    case ir::op::ARG:    return "%a" + std::to_string(_args[i->ival]);
+    default:             return "%v" + std::to_string(i->id);
+  }
+}
+
+std::string xpl::llvm_writer::cast(const std::string &value, ir::type from, ir::type to, bool expression) {
+  std::string have = type(from), want = type(to);
+  if (have == want) return value;
+  const char *op = to == ir::type::REAL ? "sitofp" : from == ir::type::REAL ? "fptosi" :
+                   to == ir::type::INT ? "ptrtoint" : "inttoptr";
+  if (expression) return std::string(op) + " (" + have + " " + value + " to " + want + ")";
+  std::string temp = "%t" + std::to_string(++_temp);
+  _os << "  " << temp << " = " << op << " " << have << " " << value << " to " << want << std::endl;
+  return temp;
+}
+
+std::string xpl::llvm_writer::use(const ir::instruction *i, ir::type ty) {
+  if (i->code == ir::op::UNDEF) return "undef";
+  if (i->code == ir::op::ICONST && ty == ir::type::REAL) return hex(i->ival);
+  if (i->code == ir::op::ICONST && ty != ir::type::INT && i->ival == 0) return "null";
+  return cast(ref(i), i->ty, ty, constant(i));
+}
+
+//---------------------------------------------------------------------------
+
+void xpl::llvm_writer::function(const ir::function &fn) {
+  _fn = &fn;
+  _args.clear();
+  _pending.clear();
+  _incoming.clear();
+  long offset = 8;  // as the builder placed them (see ir::places)
+  for (size_t k = 0; k < fn.params.size(); k++) {
+    if ((long)k < fn.registers) {
+      _args[-(long)k - 1] = k;
+    } else {
+      _args[offset] = k;
+      offset += ir::size(fn.params[k]);
+    }
+  }
+
+  // phi operands of another type: converted at the end of the block they come from
+  for (auto &b : fn.blocks)
+    for (auto i : b->code) {
+      if (i->code != ir::op::PHI) break;
+      for (size_t k = 0; k < i->operands.size(); k++) {
+        const ir::instruction *operand = i->operands[k];
+        if (std::string(type(operand->ty)) == type(i->ty) || constant(operand)) continue;
+        std::string name = "%v" + std::to_string(i->id) + "." + std::to_string(k);
+        std::ostringstream oss;
+        oss << name << " = " << (i->ty == ir::type::INT ? "ptrtoint " : "inttoptr ") << type(operand->ty) << " "
+            << ref(operand) << " to " << type(i->ty);
+        _pending[i->targets[k]].push_back(oss.str());
+        _incoming[std::make_pair(i, k)] = name;
+      }
+    }
+
+  _os << std::endl << "define " << (fn.exported ? "" : "internal ") << type(fn.ret) << " @" << fn.name
+      << "(" << parameters(fn.params, true) << ") {" << std::endl;
+  if (!fn.blocks[0]->preds.empty())  // LLVM's entry block cannot be jumped to
+    _os << "entry:" << std::endl << "  br label %b0" << std::endl;
+  for (auto &b : fn.blocks) {
+    _os << "b" << b->id << ":" << std::endl;
+    for (auto i : b->code) {
+      if (i->terminator())
+        for (auto &line : _pending[b.get()])
+          _os << "  " << line << std::endl;
+      instruction(i);
+    }
+  }
+  _os << "}" << std::endl;
+  _fn = nullptr;
+}
+
+void xpl::llvm_writer::instruction(const ir::instruction *i) {
+  std::string v = "%v" + std::to_string(i->id);
+  const char *ty = type(i->ty);
+  bool real = i->ty == ir::type::REAL;
+
+  switch (i->code) {
+    case ir::op::ICONST: case ir::op::DCONST: case ir::op::SCONST:
+    case ir::op::UNDEF: case ir::op::GLOBAL: case ir::op::ARG:
+      return;   // written where they are used (see ref)
+
+    case ir::op::SLOT: {
+      // a local whose address is taken (any value fits in 8 bytes), or an argument
+      auto arg = _args.find(i->ival);
+      std::string slot = i->ival > 0 && arg != _args.end() ? type(_fn->params[arg->second]) : "i64";
+      _os << "  " << v << ".s = alloca " << slot << ", align 8" << std::endl;
+      if (i->ival > 0 && arg != _args.end())
+        _os << "  store " << slot << " %a" << arg->second << ", " << slot << "* " << v << ".s" << std::endl;
+      _os << "  " << v << " = bitcast " << slot << "* " << v << ".s to i8*" << std::endl;
+      return;
+    }
+
+    case ir::op::ADD: case ir::op::SUB:
+      if (i->ty == ir::type::POINTER || i->ty == ir::type::STRING) {  // a pointer and a number of bytes
+        std::string base = use(i->operands[0], ir::type::POINTER);
+        std::string bytes = use(i->operands[1], ir::type::INT);
+        if (i->code == ir::op::SUB) {
+          _os << "  " << v << ".n = sub i32 0, " << bytes << std::endl;
+          bytes = v + ".n";
+        }
+        _os << "  " << v << " = getelementptr i8, i8* " << base << ", i32 " << bytes << std::endl;
+        return;
+      }
+      // fall through
+    case ir::op::MUL: case ir::op::DIV: case ir::op::MOD:
+    case ir::op::SHL: case ir::op::SAR: case ir::op::SHR: {
+      static const std::map<ir::op, std::pair<const char*, const char*>> ops = {
+        { ir::op::ADD, { "add", "fadd" } }, { ir::op::SUB, { "sub", "fsub" } },
+        { ir::op::MUL, { "mul", "fmul" } }, { ir::op::DIV, { "sdiv", "fdiv" } },
+        { ir::op::MOD, { "srem", "frem" } }, { ir::op::SHL, { "shl", "shl" } },
+        { ir::op::SAR, { "ashr", "ashr" } }, { ir::op::SHR, { "lshr", "lshr" } }
+      };
+      std::string a = use(i->operands[0], i->ty), b = use(i->operands[1], i->ty);
+      auto op = ops.at(i->code);
+      _os << "  " << v << " = " << (real ? op.second : op.first) << " " << ty << " " << a << ", " << b << std::endl;
+      return;
+    }
+    case ir::op::MULHI: {
+      std::string a = use(i->operands[0], ir::type::INT), b = use(i->operands[1], ir::type::INT);
+      _os << "  " << v << ".a = sext i32 " << a << " to i64" << std::endl;
+      _os << "  " << v << ".b = sext i32 " << b << " to i64" << std::endl;
+      _os << "  " << v << ".m = mul i64 " << v << ".a, " << v << ".b" << std::endl;
+      _os << "  " << v << ".h = ashr i64 " << v << ".m, 32" << std::endl;
+      _os << "  " << v << " = trunc i64 " << v << ".h to i32" << std::endl;
+      return;
+    }
+    case ir::op::NEG: {
+      std::string a = use(i->operands[0], i->ty);
+      _os << "  " << v << " = " << (real ? "fneg double " : "sub i32 0, ") << a << std::endl;
+      return;
+    }
+    case ir::op::NOT: {
+      std::string a = use(i->operands[0], ir::type::INT);
+      _os << "  " << v << " = xor i32 " << a << ", -1" << std::endl;
+      return;
+    }
+    case ir::op::I2D: {
+      std::string a = use(i->operands[0], ir::type::INT);
+      _os << "  " << v << " = sitofp i32 " << a << " to double" << std::endl;
+      return;
+    }
+
+    case ir::op::LT: case ir::op::LE: case ir::op::GT: case ir::op::GE: case ir::op::EQ: case ir::op::NE: {
+      static const std::map<ir::op, std::pair<const char*, const char*>> preds = {
+        { ir::op::LT, { "slt", "olt" } }, { ir::op::LE, { "sle", "ole" } },
+        { ir::op::GT, { "sgt", "ogt" } }, { ir::op::GE, { "sge", "oge" } },
+        { ir::op::EQ, { "eq", "oeq" } }, { ir::op::NE, { "ne", "une" } }
+      };
+      ir::type left = i->operands[0]->ty, right = i->operands[1]->ty;
+      ir::type operands = left == ir::type::REAL || right == ir::type::REAL ? ir::type::REAL :
+                          std::string(type(left)) == type(right) ? left : ir::type::INT;
+      std::string a = use(i->operands[0], operands), b = use(i->operands[1], operands);
+      auto pred = preds.at(i->code);
+      if (operands == ir::type::REAL)
+        _os << "  " << v << ".c = fcmp " << pred.second << " double " << a << ", " << b << std::endl;
+      else
+        _os << "  " << v << ".c = icmp " << pred.first << " " << type(operands) << " " << a << ", " << b << std::endl;
+      _os << "  " << v << " = zext i1 " << v << ".c to i32" << std::endl;
+      return;
+    }
+
+    case ir::op::LOAD: {
+      std::string where = use(i->operands[0], ir::type::POINTER);
+      _os << "  " << v << ".p = bitcast i8* " << where << " to " << ty << "*" << std::endl;
+      _os << "  " << v << " = load " << ty << ", " << ty << "* " << v << ".p" << std::endl;
+      return;
+    }
+    case ir::op::STORE: {
+      std::string where = use(i->operands[0], ir::type::POINTER);
+      const char *what = type(i->operands[1]->ty);
+      std::string value = use(i->operands[1], i->operands[1]->ty);
+      _os << "  " << v << ".p = bitcast i8* " << where << " to " << what << "*" << std::endl;
+      _os << "  store " << what << " " << value << ", " << what << "* " << v << ".p" << std::endl;
+      return;
+    }
+    case ir::op::ALLOC: {
+      std::string bytes = use(i->operands[0], ir::type::INT);
+      _os << "  " << v << " = alloca i8, i32 " << bytes << ", align 8" << std::endl;
+      return;
+    }
+
+    case ir::op::CALL: {
+      std::string name = callee(i->sval);
+      auto known = _signatures.find(name);
+      signature sig;
+      if (known != _signatures.end()) {
+        sig = known->second;
+      } else {    // not declared: typed by the call
+        sig.ret = i->ty;
+        for (auto operand : i->operands)
+          sig.params.push_back(operand->ty);
+      }
+      if (_defined.count(name) == 0) _called[name] = sig;
+      std::vector<std::string> args;
+      for (size_t k = 0; k < i->operands.size(); k++)
+        args.push_back(use(i->operands[k], k < sig.params.size() ? sig.params[k] : i->operands[k]->ty));
+      _os << "  ";
+      if (sig.ret != ir::type::VOID) _os << v << " = ";
+      _os << "call " << type(sig.ret) << " @" << name << "(";
+      for (size_t k = 0; k < args.size(); k++)
+        _os << (k > 0 ? ", " : "") << type(k < sig.params.size() ? sig.params[k] : i->operands[k]->ty)
+            << " " << args[k];
+      _os << ")" << std::endl;
+      return;
+    }
+
+    case ir::op::PHI: {
+      _os << "  " << v << " = phi " << ty;
+      for (size_t k = 0; k < i->operands.size(); k++) {
+        auto incoming = _incoming.find(std::make_pair(i, k));
+        std::string value = incoming != _incoming.end() ? incoming->second : use(i->operands[k], i->ty);
+        _os << (k > 0 ? ", [" : " [") << value << ", %b" << i->targets[k]->id << "]";
+      }
+      _os << std::endl;
+      return;
+    }
+
+    case ir::op::JMP:
+      _os << "  br label %b" << i->targets[0]->id << std::endl;
+      return;
+    case ir::op::BR: {
+      const ir::instruction *cond = i->operands[0];
+      if (cond->ty == ir::type::REAL)
+        _os << "  " << v << ".c = fcmp une double " << use(cond, ir::type::REAL) << ", " << hex(0) << std::endl;
+      else if (cond->ty == ir::type::INT)
+        _os << "  " << v << ".c = icmp ne i32 " << use(cond, ir::type::INT) << ", 0" << std::endl;
+      else
+        _os << "  " << v << ".c = icmp ne i8* " << use(cond, cond->ty) << ", null" << std::endl;
+      _os << "  br i1 " << v << ".c, label %b" << i->targets[0]->id << ", label %b" << i->targets[1]->id
+          << std::endl;
+      return;
+    }
+    case ir::op::SWITCH: {
+      _os << "  switch i32 " << use(i->operands[0], ir::type::INT) << ", label %b" << i->targets[0]->id << " [";
+      for (size_t k = 1; k < i->operands.size(); k++) {
+        long value = 0;
+        i->operands[k]->constant(value);
+        _os << " i32 " << value << ", label %b" << i->targets[k]->id;
+      }
+      _os << " ]" << std::endl;
+      return;
+    }
+    case ir::op::RET:
+      if (_fn->ret == ir::type::VOID)
+        _os << "  ret void" << std::endl;
+      else if (i->operands.empty())
+        _os << "  ret " << type(_fn->ret) << " undef" << std::endl;
+      else {
+        std::string value = use(i->operands[0], _fn->ret);
+        _os << "  ret " << type(_fn->ret) << " " << value << std::endl;
+      }
+      return;
+  }
+}
+
+//---------------------------------------------------------------------------
+
+void xpl::llvm_writer::finish() {
+  if (!_strings.empty()) _os << std::endl;
+  for (auto &s : _strings) {
+    std::ostringstream text;
+    for (unsigned char c : s.first) {
+      if (c < ' ' || c > '~' || c == '"' || c == '\\')
+        text << '\\' << std::hex << std::uppercase << std::setw(2) << std::setfill('0') << (int)c;
+      else
+        text << c;
+    }
+    _os << s.second << " = private unnamed_addr constant [" << s.first.size() + 1 << " x i8] c\""
+        << text.str() << "\\00\"" << std::endl;
+  }
+
+  if (!_called.empty() || !_unknown.empty()) _os << std::endl;
+  for (auto &name : _unknown)
+    _os << "@" << name << " = external global i8" << std::endl;
+  for (auto &fn : _called)
+    _os << "declare " << type(fn.second.ret) << " @" << fn.first << "(" << parameters(fn.second.params, false)
+        << ")" << std::endl;
+}
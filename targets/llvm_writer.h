@@ -0,0 +1,83 @@
+#ifndef __XPL_LLVM_WRITER_H__
+#define __XPL_LLVM_WRITER_H__
+
+#include <iostream>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+#include <cdk/compiler.h>
+#include <cdk/ast/sequence_node.h>
+#include "targets/ir.h"
+
+namespace xpl {
+
+  //!
+  //! Prints a program as an LLVM module (the "ll" target), for opt and
+  //! llc to optimize and compile: the globals from the program's
+  //! declarations and the functions from their SSA form (see ir_builder),
+  //! instruction by instruction. Ints are i32, reals double, and strings and
+  //! pointers i8* (loads and stores go through a bitcast to the value's
+  //! type), so the text reads both with typed and opaque pointers. Like the
+  //! native code, it assumes that pointers fit in an int: the module is for
+  //! i386 (its target triple and datalayout), so llc makes 32 bit code, to
+  //! link with the RTS, wherever it runs.
+  //!
+  class llvm_writer {
+    struct signature {
+      ir::type ret;
+      std::vector<ir::type> params;
+    };
+
+    std::shared_ptr<cdk::compiler> _compiler;
+    std::ostream &_os;
+    std::map<std::string, signature> _signatures;  // of the functions the program declares, and the RTS's
+    std::set<std::string> _defined;                // functions defined in the program
+    std::map<std::string, signature> _called;      // functions called but not defined (declared by finish)
+    std::map<std::string, std::string> _globals;   // variables, by name: their types
+    std::set<std::string> _unknown;                // addresses of names that are not variables
+    std::map<std::string, std::string> _strings;   // string literals: their constants
+
+    // the function being written: where its arguments come (see ARG), and the
+    // casts phi operands need, made at the end of the predecessor
+    const ir::function *_fn = nullptr;
+    std::map<long, size_t> _args;
+    std::map<const ir::block*, std::vector<std::string>> _pending;
+    std::map<std::pair<const ir::instruction*, size_t>, std::string> _incoming;
+    int _temp = 0;
+
+  public:
+    /** Writes the module's header and the program's variables. */
+    llvm_writer(std::shared_ptr<cdk::compiler> compiler, cdk::sequence_node * const program);
+
+    /** Writes the definition of a function. */
+    void function(const ir::function &fn);
+
+    /** Writes the string literals and the declarations of the functions used but not defined. */
+    void finish();
+
+    /** @return the LLVM type of values of an IR type */
+    static const char *type(ir::type ty);
+
+  private:
+    // The LLVM name of a function: xpl is _main (as the RTS wants), a user's _main is ._main.
+    static std::string callee(const std::string &id);
+
+    std::string string(const std::string &text);
+    std::string global(const std::string &name);
+
+    // A value as an operand of a given type: constants (and globals and
+    // strings) are written in place, converted by constant expressions;
+    // other values are converted by a cast written before.
+    std::string ref(const ir::instruction *i);
+    std::string use(const ir::instruction *i, ir::type ty);
+    bool constant(const ir::instruction *i) const;
+    std::string cast(const std::string &value, ir::type from, ir::type to, bool expression);
+
+    void instruction(const ir::instruction *i);
+  };
+
+} // xpl
+
+#endif
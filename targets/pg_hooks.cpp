@@ -0,0 +1,110 @@
+#include "targets/pg_hooks.h"
+
+//---------------------------------------------------------------------------
+
+void xpl::pg_hooks::record(const std::string &name) {
+  _pf.RODATA();
+  _pf.ALIGN();
+  _pf.LABEL(_record + ".name");
+  _pf.STR(name);
+  _pf.DATA();
+  _pf.ALIGN();
+  _pf.LABEL(_record);
+  _pf.CONST(0);              // next
+  _pf.ID(_record + ".name");
+  _pf.CONST(0);              // calls
+  _pf.DOUBLE(0);             // self cycles
+  _pf.DOUBLE(0);             // total cycles
+  _pf.CONST(0);              // calls still running
+}
+
+void xpl::pg_hooks::enter(int frame, const std::string &linked) {
+  _pf.ADDR("_pg.inner");     // the callees' cycles of the caller wait in this frame
+  _pf.DLOAD();
+  _pf.LOCAL(frame - 8);
+  _pf.DSTORE();
+  _pf.INT(0);
+  _pf.I2D();
+  _pf.ADDR("_pg.inner");
+  _pf.DSTORE();
+
+  _pf.ADDR(_record);         // first call: link the record
+  _pf.INT(8);
+  _pf.ADD();
+  _pf.LOAD();
+  _pf.JNZ(linked);
+  _pf.ADDRV("_pg.head");
+  _pf.ADDR(_record);
+  _pf.STORE();
+  _pf.ADDR(_record);
+  _pf.ADDRA("_pg.head");
+  _pf.LABEL(linked);
+  _pf.ADDR(_record);
+  _pf.INT(8);
+  _pf.ADD();
+  _pf.INCR(1);
+  _pf.TRASH(4);
+  _pf.ADDR(_record);
+  _pf.INT(28);
+  _pf.ADD();
+  _pf.INCR(1);
+  _pf.TRASH(4);
+
+  _pf.RDTSC();               // last, so that the above is not counted
+  _pf.LOCAL(frame);
+  _pf.DSTORE();
+}
+
+void xpl::pg_hooks::leave(int frame, const std::string &inner) {
+  _pf.RDTSC();               // the call's cycles, kept where its start was
+  _pf.LOCAL(frame);
+  _pf.DLOAD();
+  _pf.DSUB();
+  _pf.LOCAL(frame);
+  _pf.DSTORE();
+
+  // self += cycles - callees' cycles; total += cycles, unless a call to the same
+  // function is still running (a recursive call, already part of its cycles)
+  _pf.ADDR(_record);
+  _pf.INT(28);
+  _pf.ADD();
+  _pf.DECR(1);
+  _pf.LOAD();
+  for (int field : { 12, 20 }) {
+    if (field == 20) _pf.JNZ(inner);
+    _pf.ADDR(_record);
+    _pf.INT(field);
+    _pf.ADD();
+    _pf.DLOAD();
+    _pf.LOCAL(frame);
+    _pf.DLOAD();
+    _pf.DADD();
+    if (field == 12) {
+      _pf.ADDR("_pg.inner");
+      _pf.DLOAD();
+      _pf.DSUB();
+    }
+    _pf.ADDR(_record);
+    _pf.INT(field);
+    _pf.ADD();
+    _pf.DSTORE();
+  }
+  _pf.LABEL(inner);
+
+  _pf.LOCAL(frame - 8);      // the caller's callees' cycles now include this call
+  _pf.DLOAD();
+  _pf.LOCAL(frame);
+  _pf.DLOAD();
+  _pf.DADD();
+  _pf.ADDR("_pg.inner");
+  _pf.DSTORE();
+}
+
+// The runtime writes the flat profile (see __xpl_pg_report in rts/rts.h), to
+// the file named at the label file, from the records linked at _pg.head.
+void xpl::pg_hooks::report(const std::string &file) {
+  _pf.ADDRV("_pg.head");
+  _pf.ADDR(file);
+  _pf.CALL("__xpl_pg_report");
+  _pf.TRASH(8);
+}
@@ -0,0 +1,34 @@
+#ifndef __XPL_PG_HOOKS_H__
+#define __XPL_PG_HOOKS_H__
+
+#include <string>
+#include <cdk/emitters/basic_postfix_emitter.h>
+
+namespace xpl {
+
+  /**
+   * Function profiling (-pg): each function has a record (see __xpl_pg_record
+   * in rts/rts.h), linked into a list at _pg.head on its first call. Enter and
+   * leave time the call (the frame keeps its start and the callees' cycles at
+   * frame and frame-8, 16 bytes the function reserves); report (at the end of
+   * xpl) has the runtime write the flat profile. Labels are given by the
+   * caller (postfix_writer or ir_lowering), and imports are left to it.
+   */
+  class pg_hooks {
+    cdk::basic_postfix_emitter &_pf;
+    std::string _record;
+
+  public:
+    pg_hooks(cdk::basic_postfix_emitter &pf, const std::string &record) :
+        _pf(pf), _record(record) {
+    }
+
+    void record(const std::string &name);
+    void enter(int frame, const std::string &linked);
+    void leave(int frame, const std::string &inner);
+    void report(const std::string &file);
+  };
+
+} // xpl
+
+#endif
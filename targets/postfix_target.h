@@ -32,7 +32,7 @@ namespace xpl {
       postfix_writer writer(compiler, symtab, pf);
       compiler->ast()->accept(&writer, 0);
 
-      return true;
+      return compiler->errors() == 0;
     }
 
   };
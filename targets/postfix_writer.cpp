@@ -1,17 +1,77 @@
+#include <algorithm>
+#include <cstdlib>
+#include <set>
 #include <string>
 #include <sstream>
 #include "targets/type_checker.h"
 #include "targets/postfix_writer.h"
 #include "targets/sizeof_calculator.h"
+#include "targets/fingerprint.h"
+#include "targets/call_graph.h"
+#include "targets/ir_builder.h"
+#include "targets/ir_lowering.h"
+#include "targets/ir_passes.h"
+#include "targets/print_format.h"
+#include <cdk/cache.h>
 #include "ast/all.h"  // all.h is automatically generated
 
 //---------------------------------------------------------------------------
 
 void xpl::postfix_writer::do_sequence_node(cdk::sequence_node * const node, int lvl) {
-  for (size_t i = 0; i < node->size(); i++) {
-    if (node->node(i) != nullptr) {
-      node->node(i)->accept(this, lvl + 2);
+  if (lvl == 0) {
+    _external = xpl::external_functions(node);
+    _profile.reset(new xpl::profile(_compiler, node));
+    if (_compiler->flag("profile-use"))
+      _profile->load(_compiler, xpl::profile::file(_compiler, "profile-use"));
+  }
+  if (lvl == 0 && _compiler->optimize()) { // the program: leave out what xpl and public code never use
+    strip(node);
+  } else {
+    int line = _line;    // what follows the statements belongs to the outer one
+    for (size_t i = 0; i < node->size(); i++) {
+      if (node->node(i) != nullptr) {
+        if (infn() && debug() && node->node(i)->lineno() != _line &&
+            dynamic_cast<cdk::sequence_node*>(node->node(i)) == nullptr)
+          _pf.LINE(_line = node->node(i)->lineno(), "");
+        size_t printed = infn() && coalescing() ? prints(node, i, lvl + 2) : 0;
+        if (printed > 0)
+          i += printed - 1;
+        else
+          node->node(i)->accept(this, lvl + 2);
+      }
+    }
+    if (infn() && debug() && line != _line) _pf.LINE(_line = line, "");
+  }
+  if (lvl == 0 && _compiler->flag("profile-generate")) {  // the counters, after a header (see profile)
+    _pf.DATA();
+    _pf.ALIGN();
+    _pf.LABEL(reserved("prof"));
+    _pf.CONST(_profile->checksum());
+    _pf.CONST(_profile->size());
+    for (size_t k = 0; k < _profile->size(); k++) {
+      _pf.LABEL(reserved("prof." + std::to_string(k)));
+      _pf.CONST(0);
     }
+    _pf.RODATA();
+    _pf.ALIGN();
+    _pf.LABEL(reserved("prof.file"));
+    _pf.STR(xpl::profile::file(_compiler, "profile-generate"));
+  }
+  if (lvl == 0 && _compiler->flag("pg") && defined.count("xpl") > 0) {  // the list of records (see pg_hooks)
+    _pf.DATA();
+    _pf.ALIGN();
+    _pf.GLOBAL("_pg.head", _pf.OBJ());
+    _pf.LABEL("_pg.head");
+    _pf.CONST(0);
+    _pf.GLOBAL("_pg.inner", _pf.OBJ());
+    _pf.LABEL("_pg.inner");
+    _pf.DOUBLE(0);
+    _pf.RODATA();
+    _pf.ALIGN();
+    _pf.LABEL(reserved("pg.file"));   // written by the runtime (see pg_hooks::report)
+    _pf.STR(xpl::profile::file(_compiler, "pg", ".pg"));
+    addId(&defined, "_pg.head");
+    addId(&defined, "_pg.inner");
   }
   if (lvl == 0) {// If this is the main sequence, verify what to it needs to import
     std::set<std::string> importlist = getImports();
@@ -32,6 +92,130 @@ void xpl::postfix_writer::do_sequence_node(cdk::sequence_node * const node, int
   }
 }
 
+// Whether computing an expression has no effects (calls, reads, assignments
+// or allocations), so that it may be computed out of order.
+static bool effectless(cdk::basic_node * const node) {
+  if (dynamic_cast<cdk::integer_node*>(node) || dynamic_cast<cdk::double_node*>(node) ||
+      dynamic_cast<cdk::string_node*>(node) || dynamic_cast<cdk::identifier_node*>(node))
+    return true;
+  if (auto rvalue = dynamic_cast<cdk::rvalue_node*>(node))
+    return effectless(rvalue->lvalue());
+  if (auto index = dynamic_cast<xpl::index_node*>(node))
+    return effectless(index->expression()) && effectless(index->shift());
+  if (dynamic_cast<xpl::memalloc_node*>(node))
+    return false;
+  if (auto unary = dynamic_cast<cdk::unary_expression_node*>(node))
+    return effectless(unary->argument());
+  if (auto binary = dynamic_cast<cdk::binary_expression_node*>(node))
+    return effectless(binary->left()) && effectless(binary->right());
+  return false;
+}
+
+// Whether computing an expression cannot trap (it has no division, which may
+// be by zero, and no indexing, which may be through a bad pointer), so that
+// what was printed before may wait for it.
+static bool trapless(cdk::basic_node * const node) {
+  if (dynamic_cast<xpl::index_node*>(node) || dynamic_cast<cdk::div_node*>(node) ||
+      dynamic_cast<cdk::mod_node*>(node))
+    return false;
+  if (auto rvalue = dynamic_cast<cdk::rvalue_node*>(node))
+    return trapless(rvalue->lvalue());
+  if (auto unary = dynamic_cast<cdk::unary_expression_node*>(node))
+    return trapless(unary->argument());
+  if (auto binary = dynamic_cast<cdk::binary_expression_node*>(node))
+    return trapless(binary->left()) && trapless(binary->right());
+  return true;
+}
+
+size_t xpl::postfix_writer::prints(cdk::sequence_node * const node, size_t first, int lvl) {
+  xpl::print_format format;
+  std::vector<cdk::expression_node*> values;
+  size_t count = 0;
+  std::unique_ptr<xpl::type_checker> checker;   // for the values with no type yet (one for all)
+  for (size_t i = first; i < node->size(); i++, count++) {
+    auto print = dynamic_cast<xpl::print_node*>(node->node(i));
+    if (print == nullptr || !effectless(print->argument())) break;
+    if (count > 0 && !trapless(print->argument())) break;  // the prints before it would wait
+    cdk::expression_node *argument = print->argument();
+    if (argument->type() == nullptr || argument->type()->name() == basic_type::TYPE_UNSPEC) {
+      try {
+        if (checker == nullptr) checker.reset(new xpl::type_checker(_compiler, _symtab, this));
+        print->accept(checker.get(), 0);
+      } catch (const std::string &problem) {
+        break;  // reported when it is printed by itself
+      }
+    }
+
+    type argtype = argument->type()->name();
+    auto integer = dynamic_cast<cdk::integer_node*>(argument);
+    auto text = dynamic_cast<cdk::string_node*>(argument);
+    if (argtype == basic_type::TYPE_INT && integer != nullptr)
+      format.text(std::to_string(integer->value()));
+    else if (text != nullptr)
+      format.text(text->value());
+    else if (argtype == basic_type::TYPE_INT || argtype == basic_type::TYPE_DOUBLE ||
+             argtype == basic_type::TYPE_STRING) {
+      format.value(argtype == basic_type::TYPE_INT ? "printi" : argtype == basic_type::TYPE_DOUBLE ? "printd" : "prints");
+      values.push_back(argument);
+    } else
+      break;
+    if (print->newline()) format.newline();
+  }
+  if (format.calls() < 2) return 0;
+
+  int bytes = 4;
+  for (size_t k = values.size(); k-- > 0;) {  // pushed last to first, after the format
+    values[k]->accept(this, lvl);
+    bytes += values[k]->type()->size();
+  }
+  int lbl = ++_lbl;
+  _pf.RODATA();
+  _pf.ALIGN();
+  _pf.LABEL(mklbl(lbl));
+  _pf.STR(format.format());
+  _pf.TEXT();
+  _pf.ADDR(mklbl(lbl));
+  if (format.values() > 0) addId(&imports, xpl::print_format::printer());
+  _pf.CALL(format.values() > 0 ? xpl::print_format::printer() : "prints");
+  _pf.TRASH(bytes);
+  return count;
+}
+
+void xpl::postfix_writer::strip(cdk::sequence_node * const node) {
+  xpl::call_graph graph(_compiler, node);
+  std::ostringstream unused;     // the code of what is left out (compiled, so errors are still found)
+  int functions = 0, variables = 0;
+
+  for (size_t i = 0; i < node->size(); i++) {
+    cdk::basic_node *decl = node->node(i);
+    if (decl == nullptr) continue;
+
+    auto fn = dynamic_cast<xpl::function_node*>(decl);
+    auto var = dynamic_cast<xpl::decl_variable_node*>(decl);
+    if ((fn == nullptr || graph.used(*fn->name())) &&
+        (var == nullptr || var->toImport() || graph.used(*var->name()))) {
+      decl->accept(this, 2);
+      continue;
+    }
+
+    std::ostream &out = os();
+    std::streambuf *outbuf = out.rdbuf(unused.rdbuf());
+    std::set<std::string> outerImports;
+    imports.swap(outerImports);
+    decl->accept(this, 2);
+    imports.swap(outerImports);
+    out.rdbuf(outbuf);
+    fn != nullptr ? functions++ : variables++;
+  }
+
+  if (functions + variables > 0) {
+    std::ostringstream remark;
+    remark << "strip: " << functions << " function(s) and " << variables
+           << " variable(s) never used, " << unused.str().size() << " bytes of assembly saved";
+    _compiler->remark(remark.str());
+  }
+}
+
 //------------ LITERALS -----------------------------------------------------
 
 void xpl::postfix_writer::do_integer_node(cdk::integer_node * const node, int lvl) {
@@ -338,12 +522,10 @@ void xpl::postfix_writer::do_and_node(cdk::and_node * const node, int lvl) {
   _pf.INT(1);
   _pf.JMP(mklbl(end));
 
-  _pf.ALIGN();
-  _pf.LABEL(mklbl(fail));
+  label(fail);
   _pf.INT(0);
 
-  _pf.ALIGN();
-  _pf.LABEL(mklbl(end));
+  label(end);
 }
 void xpl::postfix_writer::do_or_node(cdk::or_node * const node, int lvl) {
   ASSERT_SAFE_EXPRESSIONS
@@ -364,12 +546,10 @@ void xpl::postfix_writer::do_or_node(cdk::or_node * const node, int lvl) {
   _pf.INT(0);
   _pf.JMP(mklbl(end));
 
-  _pf.ALIGN();
-  _pf.LABEL(mklbl(pass));
+  label(pass);
   _pf.INT(1);
 
-  _pf.ALIGN();
-  _pf.LABEL(mklbl(end));
+  label(end);
 }
 
 //------------ EXPRESSIONS --------------------------------------------------
@@ -443,9 +623,21 @@ void xpl::postfix_writer::do_assignment_node(cdk::assignment_node * const node,
 void xpl::postfix_writer::do_funcall_node(xpl::funcall_node * const node, int lvl) {
   ASSERT_SAFE_EXPRESSIONS
 
+  int callsize = node->type()->size();
+  call(node, lvl);
+
+  if (callsize == 4) {
+    _pf.PUSH();
+  } else if (callsize == 8) {
+    _pf.DPUSH();
+  }
+}
+
+void xpl::postfix_writer::call(xpl::funcall_node * const node, int lvl) {
+  ASSERT_SAFE_EXPRESSIONS
+
   std::string &id = *(node->name());
   auto symbol = _symtab.find(id);
-  int callsize = node->type()->size();
   int argsize = 0;
 
   if (symbol->toImport()) {
@@ -460,16 +652,16 @@ void xpl::postfix_writer::do_funcall_node(xpl::funcall_node * const node, int lv
     }
   }
 
+  // Internal functions take the first ones (now on top) in registers
+  for (size_t i = 0; i < symbol->registers(); i++) {
+    _pf.POPR(i);
+    argsize -= 4;
+  }
+
   _pf.CALL(id);
 
   // Remove arguments from stack
   _pf.TRASH(argsize);
-
-  if (callsize == 4) {
-    _pf.PUSH();
-  } else if (callsize == 8) {
-    _pf.DPUSH();
-  }
 }
 
 void xpl::postfix_writer::do_index_node(xpl::index_node * const node, int lvl) {
@@ -508,18 +700,27 @@ void xpl::postfix_writer::do_body_node(xpl::body_node * const node, int lvl) {
     if(node->instructions()) { node->instructions()->accept(this, lvl+2); }
 }
 void xpl::postfix_writer::do_block_node(xpl::block_node * const node, int lvl) {
+    int offset = _offset; // The block's slots are free again after it (see sizeof_calculator)
     _symtab.push();
 
     if(node->declarations()) { node->declarations()->accept(this, lvl+2); }
     if(node->instructions()) { node->instructions()->accept(this, lvl+2); }
 
     _symtab.pop();
+    _offset = offset;
 }
 
 void xpl::postfix_writer::do_evaluation_node(xpl::evaluation_node * const node, int lvl) {
   ASSERT_SAFE_EXPRESSIONS;
   int evalsize = node->argument()->type()->size();
 
+  // A call whose result is not wanted leaves it in eax (doubles are still popped from st0)
+  auto funcall = dynamic_cast<xpl::funcall_node*>(node->argument());
+  if (funcall != nullptr && evalsize != 8) {
+    call(funcall, lvl+2);
+    return;
+  }
+
   // Do the expression
   node->argument()->accept(this, lvl+2);
 
@@ -527,6 +728,132 @@ void xpl::postfix_writer::do_evaluation_node(xpl::evaluation_node * const node,
   _pf.TRASH(evalsize); 
 }
 
+std::string xpl::postfix_writer::fragment_key(xpl::function_node * const node) {
+  xpl::fingerprint fp(_compiler);
+  node->accept(&fp, 0);
+
+  std::ostringstream text;
+  text << fp.text();
+  std::set<std::string> names = fp.names();
+  names.insert(*node->name());     // its own calling convention
+  for (auto &name : names) {
+    auto symbol = _symtab.find(name);
+    text << "\n" << name << " ";
+    if (symbol == nullptr) {
+      text << "?";
+      continue;
+    }
+    text << symbol->toImport() << symbol->local() << symbol->fn() << symbol->internal() << " "
+         << xpl::fingerprint::text(symbol->type());
+    for (auto arg : symbol->getArgs())
+      text << " " << xpl::fingerprint::text(&arg);
+    auto callee = _inlinable.find(name);   // its code may be copied into this one
+    if (callee != _inlinable.end()) {
+      text << "\n";
+      callee->second->print(text);
+    }
+  }
+  text << "\nprofile " << _profile->text(node);
+  return _compiler->cache()->key("xpl", text.str(), "fn", _compiler->optimize(), debug(),
+                                   _compiler->flags());
+}
+
+bool xpl::postfix_writer::replay(const std::string &fragment) {
+  // Fragment layout: "imports <ids>\n" "defined <ids>\n" "inlinable <0|1>\n" followed by the code
+  std::istringstream in(fragment);
+  std::string line, word;
+  for (auto list : { &imports, &defined }) {
+    std::getline(in, line);
+    std::istringstream names(line);
+    names >> word; // list name
+    while (names >> word) addId(list, word);
+  }
+  bool inlinable = false;
+  std::getline(in, line);
+  std::istringstream(line) >> word >> inlinable;
+  if (in.peek() != std::char_traits<char>::eof())
+    os() << in.rdbuf();
+  return inlinable;
+}
+
+std::string xpl::postfix_writer::name(const std::string &id) {
+  if (id == "_main") return "._main";  // In case there's a function with reserved name, change it
+  if (id == "xpl") return "_main";     // (RTS mandates the main function have name be "_main")
+  return id;
+}
+
+std::unique_ptr<xpl::ir::function> xpl::postfix_writer::ssa(xpl::function_node * const node,
+                                                            std::shared_ptr<xpl::symbol> symbol,
+                                                            const std::string &id) {
+  xpl::ir_builder builder(_compiler, _symtab, imports, defined);
+  builder.profile(_profile.get());
+  auto fn = builder.build(node, symbol, id);
+  if (fn != nullptr) {
+    int budget = std::atoi(_compiler->flag("unroll-budget", "64").c_str());
+    if (_compiler->optimize()) xpl::ir::optimize(*fn, _inlinable, budget);
+    if (coalescing() && xpl::ir::coalesce_prints(*fn))
+      for (auto &b : fn->blocks)
+        for (auto i : b->code)
+          if (i->code == xpl::ir::op::CALL && i->sval == xpl::print_format::printer())
+            addId(&imports, i->sval);
+  }
+  return fn;
+}
+
+bool xpl::postfix_writer::keep(xpl::function_node * const node, std::unique_ptr<ir::function> &fn) {
+  int threshold = std::atoi(_compiler->flag("inline-threshold", "16").c_str());
+  if (_profile->hot(node)) threshold *= 4;    // calls to it are worth more code
+  if (_profile->cold(node)) threshold = -1;   // never called
+  if (!_compiler->optimize() || !xpl::ir::inlinable(*fn, threshold)) return false;
+  _inlinable[fn->name] = std::move(fn);
+  return true;
+}
+
+void xpl::postfix_writer::count(const cdk::basic_node *node, int arm) {
+  if (!_compiler->flag("profile-generate")) return;
+  _pf.ADDR(reserved("prof." + std::to_string(_profile->counter(node, arm))));
+  _pf.INCR(1);
+  _pf.TRASH(4);
+}
+
+// open, write and close the profile file (Linux system calls: there is no library for files)
+void xpl::postfix_writer::dump() {
+  _pf.INT(0644);              // mode
+  _pf.INT(01 | 0100 | 01000); // O_WRONLY | O_CREAT | O_TRUNC
+  _pf.ADDR(reserved("prof.file"));
+  _pf.INT(5);                 // open
+  _pf.SYSCALL(3);
+  _pf.DUP();                  // the file stays for close
+  _pf.INT(4 * (_profile->size() + 2));
+  _pf.SWAP();
+  _pf.ADDR(reserved("prof"));
+  _pf.SWAP();
+  _pf.INT(4);                 // write(file, header and counters, bytes)
+  _pf.SYSCALL(3);
+  _pf.TRASH(4);
+  _pf.INT(6);                 // close
+  _pf.SYSCALL(1);
+  _pf.TRASH(4);
+}
+
+void xpl::postfix_writer::label(int lbl, const cdk::basic_node *loop) {
+  if (!_profile->loaded() || (loop != nullptr && _profile->hot(loop))) _pf.ALIGN();
+  _pf.LABEL(mklbl(lbl));
+}
+
+bool xpl::postfix_writer::outline(const cdk::basic_node *node, int arm) {
+  return !_incold && _profile->cold(node, arm);
+}
+
+void xpl::postfix_writer::cold(const std::function<void()> &code) {
+  std::ostream &out = os();
+  std::streambuf *outbuf = out.rdbuf(_cold.rdbuf());
+  _incold = true;
+  code();
+  _incold = false;
+  out.rdbuf(outbuf);
+}
+
 void xpl::postfix_writer::do_function_node(xpl::function_node * const node, int lvl) {
   ASSERT_SAFE_EXPRESSIONS;
 
@@ -536,106 +863,198 @@ void xpl::postfix_writer::do_function_node(xpl::function_node * const node, int
   auto symbol = _symtab.find(id);     // Get function from symtab is exists
   int retsize = node->type()->size(); // Default space for return result
   _offset = 0;                        // Reset offset value
-  _rtrnlbl = ++_lbl;                  // Label for return to jump to end of function
   addId(&defined, id);                // Add function to list of defineds
   /************************************/
 
   if ( symbol == nullptr) {   // If symbol is not created, create
     symbol = std::make_shared<xpl::symbol>
       (node->toImport(), true, true, true, node->type(), id, 0);
+    symbol->internal(_external.count(id) == 0);
     _symtab.insert(id, symbol);
   }
 
-  if (id == "_main") { // In case there's a function with reserved name, change it
-    id = "._main";
+  // If the function wasn't defined, add its arguments to list
+  // Dynamic cast used because through grammar we know args are decl_vars
+  if (node->argument() != nullptr && symbol->getArgs().empty()) {
+    for (size_t i = 0; i < node->argument()->size(); i++) {
+      if (node->argument()->node(i) != nullptr) {   
+        try {
+          auto *decl = dynamic_cast <xpl::decl_variable_node*> (node->argument()->node(i)); 
+          symbol->addArg( *(decl->type()) );
+        } catch (std::bad_cast e) {
+          // Sequence node is unreliable in its size, so this is ok.
+        }
+      } 
+    }
+  }
+  symbol->value(-retsize);            // The function's name is its return value
+
+  /********** Reuse unchanged code from previous compilations **********/
+  std::string key, fragment;
+  cdk::cache *cache = _compiler->cache();
+  if (cache != nullptr) {
+    key = fragment_key(node);
+    if (cache->load(key, fragment)) {
+      // callers may inline it: its SSA form is made again, as it was then (but not lowered)
+      if (replay(fragment)) {
+        auto fn = ssa(node, symbol, name(id));
+        if (fn != nullptr) keep(node, fn);
+      }
+      infn(false);
+      return;
+    }
   }
 
-  if (id == "xpl") {   //(RTS mandates the main function have name be "_main")
-    id = "_main";
+  // Capture the code, imports and definitions of this function only
+  std::ostream &out = os();
+  std::streambuf *outbuf = out.rdbuf();
+  std::ostringstream code;
+  std::set<std::string> outerImports, outerDefined;
+  int errors = _compiler->errors();
+  if (cache != nullptr) {
+    out.rdbuf(code.rdbuf());
+    imports.swap(outerImports);
+    defined.swap(outerDefined);
+  }
+  /*********************************************************************/
+
+  id = name(id);
+
+  bool pg = _compiler->flag("pg"), inlinable = false;
+  std::string record = reserved("pg.rec." + id);  // with -pg (named as in the source)
+  xpl::pg_hooks hooks(_pf, record);
+  if (pg) {
+    hooks.record(id == "_main" ? "xpl" : id == "._main" ? "_main" : id);
+    addId(&imports, "_pg.head");
+    addId(&imports, "_pg.inner");
+    if (id == "_main") addId(&imports, "__xpl_pg_report");
   }
 
-  _pf.TEXT();
-  _pf.ALIGN();
-  if (node->toExport()) { _pf.GLOBAL(id, _pf.FUNC()); }
-  _pf.LABEL(id);
-
-  /********** Alocate size of all variables inside function **********/
-  xpl::sizeof_calculator *visitor = new xpl::sizeof_calculator(_compiler);
-  node->accept(visitor, 0);
-  int size = visitor->size();
-  delete visitor;
-  _pf.ENTER(size);
-  /***************************************************************/
-
-  _symtab.push();
-
-  /**************** Alocate space for arguments ******************/
-  if (node->argument() != nullptr) {
-    _argdcl = true; // Flag for decl_var so it knows update offset after aloc
-    _offset = 8;    // Stack zone for arguments
-    node->argument()->accept(this, lvl+2); 
-
-    // If the function wasn't defined, add its arguments to list
-    // Dynamic cast used because through grammar we know args are decl_vars
-    if (symbol->getArgs().empty()) {
-      for (size_t i = 0; i < node->argument()->size(); i++) {
-        if (node->argument()->node(i) != nullptr) {   
-          try {
-            auto *decl = dynamic_cast <xpl::decl_variable_node*> (node->argument()->node(i)); 
-            symbol->addArg( *(decl->type()) );
-          } catch (std::bad_cast e) {
-            // Sequence node is unreliable in its size, so this is ok.
-          }
-        } 
+  // through the SSA form (see targets/ir.h), except when counting: the counters are in the syntax tree
+  if ((_compiler->flag("ir") || _compiler->optimize()) && !_compiler->flag("profile-generate")) {
+    auto fn = ssa(node, symbol, id);
+    if (fn != nullptr) {
+      xpl::ir_lowering lowering(_pf, *fn);
+      if (pg) lowering.pg(record, id == "_main" ? reserved("pg.file") : "");
+      lowering.lower();
+      inlinable = keep(node, fn);
+    }
+  } else {
+    int outerlbl = _lbl;                // Labels are numbered from 1 in each function
+    _lbl = 0;
+    _lblscope = id;
+    _rtrnlbl = ++_lbl;                  // Label for return to jump to end of function
+
+    _pf.TEXT();
+    _pf.ALIGN();
+    if (debug()) {  // perf and debuggers see the function's extent and lines
+      std::string type = _pf.FUNC(id, mklbl(0));
+      node->toExport() ? _pf.GLOBAL(id, type) : _pf.STATIC(id, type);
+      _pf.LINE(_line = node->lineno(), _compiler->ifile());
+    } else if (node->toExport()) { _pf.GLOBAL(id, _pf.FUNC()); }
+    _pf.LABEL(id);
+
+    /********** Alocate size of all variables inside function **********/
+    xpl::sizeof_calculator *visitor = new xpl::sizeof_calculator(_compiler);
+    node->accept(visitor, 0);
+    size_t registers = symbol->registers();
+    int size = visitor->size() + 4 * registers; // arguments passed in registers are kept there too
+    int start = -(size + 8);                    // with -pg, below the variables (see pg_hooks)
+    if (pg) size += 16;
+    delete visitor;
+    _pf.ENTER(size);
+    /***************************************************************/
+
+    _symtab.push();
+
+    /**************** Alocate space for arguments ******************/
+    if (node->argument() != nullptr) {
+      _argdcl = true; // Flag for decl_var so it knows update offset after aloc
+      _offset = 8;    // Stack zone for arguments
+      for (size_t i = registers; i < node->argument()->size(); i++) {
+        if (node->argument()->node(i) != nullptr) { node->argument()->node(i)->accept(this, lvl+2); }
       }
+      _argdcl = false;
+      _offset = 0;    // Stack zone for variables
     }
-    _argdcl = false;
-    _offset = 0;    // Stack zone for variables
-  }
-  /***************************************************************/
+    /***************************************************************/
 
-  /********** Alocate space for literal / return value **********/
-  _offset -= retsize;
-  if (node->literal()) {                      // If fn has a literal defined
-    node->literal()->accept(this, lvl+2);     // Put it on the stack fp - retsize
-    if (retsize == 4) {                       
+    /********** Alocate space for literal / return value **********/
+    _offset -= retsize;
+    for (size_t i = 0; i < registers; i++) {    // Arguments in registers: stored as locals
+      node->argument()->node(i)->accept(this, lvl+2);   // before anything overwrites them
+      _pf.PUSHR(i);
       _pf.LOCA(_offset);
-    } else if (retsize == 8) {
-      _pf.LOCAL(_offset);
-      _pf.DSTORE();
     }
-  }
-  symbol->value(_offset);
-  /***************************************************************/
+    if (node->literal()) {                      // If fn has a literal defined
+      node->literal()->accept(this, lvl+2);     // Put it on the stack fp - retsize
+      if (retsize == 4) {                       
+        _pf.LOCA(-retsize);
+      } else if (retsize == 8) {
+        _pf.LOCAL(-retsize);
+        _pf.DSTORE();
+      }
+    }
+    /***************************************************************/
 
-  node->body()->accept(this, lvl+2);
+    count(node);
+    if (pg) hooks.enter(start, mklbl(++_lbl));
+    node->body()->accept(this, lvl+2);
 
-  _symtab.pop();
+    _symtab.pop();
 
-  _pf.ALIGN();
-  _pf.LABEL(mklbl(_rtrnlbl));
-
-  /************* If there's a return value, pop it ***************/
-  if (retsize == 4) {        // Int, string or pointer 
-    _pf.LOCV(-4);
-    _pf.POP();
-  } else if (retsize == 8) { // Double
-    _pf.LOCAL(-8);
-    _pf.DLOAD();
-    _pf.DPOP();
-  }
-  /***************************************************************/
+    label(_rtrnlbl);
+    if (pg) hooks.leave(start, mklbl(++_lbl));
+    if (id == "_main" && pg) hooks.report(reserved("pg.file"));
+    if (id == "_main" && _compiler->flag("profile-generate")) dump();
+
+    /************* If there's a return value, pop it ***************/
+    if (retsize == 4) {        // Int, string or pointer 
+      _pf.LOCV(-4);
+      _pf.POP();
+    } else if (retsize == 8) { // Double
+      _pf.LOCAL(-8);
+      _pf.DLOAD();
+      _pf.DPOP();
+    }
+    /***************************************************************/
 
-  _pf.LEAVE();
-  _pf.RET();
+    _pf.LEAVE();
+    _pf.RET();
+    os() << _cold.str();
+    _cold.str("");
+    if (debug()) _pf.LABEL(mklbl(0));
 
+    _lblscope = "";
+    _lbl = outerlbl;
+  }
   infn(false);
+
+  /********** Keep the function's code for later compilations **********/
+  if (cache != nullptr) {
+    out.rdbuf(outbuf);
+    std::ostringstream entry;
+    for (auto list : { std::make_pair("imports", &imports), std::make_pair("defined", &defined) }) {
+      entry << list.first;
+      for (auto &name : *list.second) entry << " " << name;
+      entry << "\n";
+    }
+    entry << "inlinable " << inlinable << "\n";
+    entry << code.str();
+    if (_compiler->errors() == errors)
+      cache->save(key, entry.str());
+
+    replay(entry.str());
+    imports.insert(outerImports.begin(), outerImports.end());
+    defined.insert(outerDefined.begin(), outerDefined.end());
+  }
+  /*********************************************************************/
 }
 
 void xpl::postfix_writer::do_next_node(xpl::next_node * const node, int lvl) {
   if (_nextList.empty()) {
-    std::cerr << node->lineno() <<": Next outside loop." << std::endl;
-    exit(2);
+    _compiler->error(node->lineno(), "Next outside loop.");
+    return;
   }
 
   _pf.JMP(mklbl(_nextList.back()));
@@ -657,8 +1076,8 @@ void xpl::postfix_writer::do_print_node(xpl::print_node * const node, int lvl) {
     _pf.CALL("prints");
     _pf.TRASH(4); // delete the printed value's address
   } else {
-    std::cerr << "Print error: Can't print " << printType(argtype) << std::endl;
-    exit(2);
+    _compiler->error(node->lineno(), "Print error: Can't print " + printType(argtype));
+    return;
   }
 
   if (node->newline()) {
@@ -672,8 +1091,8 @@ void xpl::postfix_writer::do_return_node(xpl::return_node * const node, int lvl)
 
 void xpl::postfix_writer::do_stop_node(xpl::stop_node * const node, int lvl) {
   if (_stopList.empty()) {
-    std::cerr << node->lineno() <<": Stop outside loop." << std::endl;
-    exit(2);
+    _compiler->error(node->lineno(), "Stop outside loop.");
+    return;
   } 
   _pf.JMP(mklbl(_stopList.back()));
 }
@@ -696,8 +1115,7 @@ void xpl::postfix_writer::decl_init_check(xpl::decl_variable_node * const node,
     if ( &(dynamic_cast <cdk::string_node&> (*node->init())) != nullptr ) { return; }
   } catch (std::bad_cast e) { }
     
-  std::cerr << node->lineno() <<": A global variable can only be initialized with a literal" << std::endl;
-  exit(2);
+  throw std::string("A global variable can only be initialized with a literal");
 }
 
 void xpl::postfix_writer::decl_initiator(xpl::decl_variable_node * const node, int lvl) {
@@ -746,7 +1164,14 @@ void xpl::postfix_writer::do_decl_variable_node(xpl::decl_variable_node * const
 
   } else {      // GLOBAL
 
-    if (init) { decl_init_check(node, lvl+2); }
+    if (init) {
+      try {
+        decl_init_check(node, lvl+2);
+      } catch (const std::string &problem) {
+        _compiler->error(node->lineno(), problem);
+        return;
+      }
+    }
     _adrvar = id;       // Saving in global variable var id in case of string
     init ? _pf.DATA() : _pf.BSS();
     _pf.ALIGN();
@@ -762,6 +1187,7 @@ void xpl::postfix_writer::do_decl_function_node(xpl::decl_function_node * const
   std::string &id = *(node->name());
   auto symbol = std::make_shared<xpl::symbol>
     (node->toImport(), true, true, false, node->type(), id, 0);
+  symbol->internal(_external.count(id) == 0);
 
   // Add function arguments to symbol
   for (size_t i = 0; i < node->argument()->size(); i++) {
@@ -776,7 +1202,7 @@ void xpl::postfix_writer::do_decl_function_node(xpl::decl_function_node * const
   }
 
   if (!_symtab.insert(id, symbol)) {
-    throw std::string("Error inserting new function " + id + " symbol.");
+    _compiler->error(node->lineno(), "Error inserting new function " + id + " symbol.");
   }
 }
 
@@ -788,10 +1214,84 @@ void xpl::postfix_writer::do_if_node(xpl::if_node * const node, int lvl) {
   int lbl1;
 
   node->condition()->accept(this, lvl+2);
+  if (outline(node)) {  // never taken: the block waits after the function
+    int back = ++_lbl;
+    _pf.JNZ(mklbl(lbl1 = ++_lbl));
+    label(back);
+    cold([&]() {
+      label(lbl1);
+      count(node);
+      node->block()->accept(this, lvl+2);
+      _pf.JMP(mklbl(back));
+    });
+    return;
+  }
   _pf.JZ(mklbl(lbl1 = ++_lbl));
+  count(node);
   node->block()->accept(this, lvl+2);
+  label(lbl1);
+}
+
+void xpl::postfix_writer::dispatch(cdk::expression_node * const scrutinee,
+                                   const std::vector<std::pair<int, int>> &arms, int none, int lvl) {
+  long long low = arms.front().first, range = (long long)arms.back().first - low + 1;
+  if (!ir::dense(low, arms.back().first, arms.size())) {
+    search(scrutinee, arms, 0, arms.size(), none, lvl);
+    return;
+  }
+
+  // (unsigned) scrutinee - low < range, then jump through the table
+  int table = ++_lbl;
+  scrutinee->accept(this, lvl);
+  _pf.INT(low);
+  _pf.SUB();
+  _pf.INT(range);
+  _pf.ULT();
+  _pf.JZ(mklbl(none));
+  scrutinee->accept(this, lvl);
+  _pf.INT(low);
+  _pf.SUB();
+  _pf.INT(2);
+  _pf.SHTL();
+  _pf.ADDR(mklbl(table));
+  _pf.ADD();
+  _pf.LOAD();
+  _pf.LEAP();
+
+  _pf.RODATA();
   _pf.ALIGN();
-  _pf.LABEL(mklbl(lbl1));
+  _pf.LABEL(mklbl(table));
+  size_t k = 0;
+  for (long long value = low; value < low + range; value++) {
+    bool arm = arms[k].first == value;
+    _pf.ID(mklbl(arm ? arms[k].second : none));
+    if (arm) k++;
+  }
+  _pf.TEXT();
+}
+
+void xpl::postfix_writer::search(cdk::expression_node * const scrutinee,
+                                 const std::vector<std::pair<int, int>> &arms, size_t lo, size_t hi,
+                                 int none, int lvl) {
+  if (hi - lo <= 3) {
+    for (size_t k = lo; k < hi; k++) {
+      scrutinee->accept(this, lvl);
+      _pf.INT(arms[k].first);
+      _pf.EQ();
+      _pf.JNZ(mklbl(arms[k].second));
+    }
+    _pf.JMP(mklbl(none));
+    return;
+  }
+  size_t mid = (lo + hi) / 2;
+  int lower = ++_lbl;
+  scrutinee->accept(this, lvl);
+  _pf.INT(arms[mid].first);
+  _pf.LT();
+  _pf.JNZ(mklbl(lower));
+  search(scrutinee, arms, mid, hi, none, lvl);
+  label(lower);
+  search(scrutinee, arms, lo, mid, none, lvl);
 }
 
 void xpl::postfix_writer::do_if_else_node(xpl::if_else_node * const node, int lvl) {
@@ -799,15 +1299,56 @@ void xpl::postfix_writer::do_if_else_node(xpl::if_else_node * const node, int lv
 
   int lbl1, lbl2;
 
+  // elsif chains testing one variable against 4 or more literals are dispatched (tables or binary search)
+  std::unique_ptr<xpl::switch_chain> chain;
+  if (_chained.erase(node) == 0) {   // or read with its head
+    chain.reset(new xpl::switch_chain(_compiler, _symtab, this, node));
+    _chained.insert(chain->chained.begin(), chain->chained.end());
+  }
+  if (chain && chain->arms.size() >= ir::SWITCH_CASES && !_compiler->flag("profile-generate")) {
+    auto &arms = chain->arms;      // (with -fprofile-generate, arms are counted one by one)
+    int end = ++_lbl, none = ++_lbl;
+    std::vector<std::pair<int, int>> labels;   // value, label
+    for (auto &arm : arms)
+      labels.push_back(std::make_pair(arm.first, ++_lbl));
+    std::vector<std::pair<int, int>> sorted = labels;
+    std::sort(sorted.begin(), sorted.end());
+    dispatch(chain->scrutinee, sorted, none, lvl+2);
+    for (size_t k = 0; k < arms.size(); k++) {
+      label(labels[k].second);
+      arms[k].second->accept(this, lvl+2);
+      _pf.JMP(mklbl(end));
+    }
+    label(none);
+    if (chain->otherwise != nullptr) chain->otherwise->accept(this, lvl+2);
+    label(end);
+    return;
+  }
+
+  // The arm that ran more often falls through; the other waits after the function if it never ran
+  cdk::basic_node *blocks[] = { node->thenblock(), node->elseblock() };
+  int arm = _profile->count(node, 1) > _profile->count(node, 0) ? 1 : 0, other = 1 - arm;
+
   node->condition()->accept(this, lvl+2);
-  _pf.JZ(mklbl(lbl1 = ++_lbl));
-  node->thenblock()->accept(this, lvl+2);
-  _pf.JMP(mklbl(lbl2 = ++_lbl));
-  _pf.ALIGN();
-  _pf.LABEL(mklbl(lbl1));
-  node->elseblock()->accept(this, lvl+2);
-  _pf.ALIGN();
-  _pf.LABEL(mklbl(lbl1 = lbl2));
+  arm == 0 ? _pf.JZ(mklbl(lbl1 = ++_lbl)) : _pf.JNZ(mklbl(lbl1 = ++_lbl));
+  count(node, arm);
+  blocks[arm]->accept(this, lvl+2);
+  lbl2 = ++_lbl;
+  if (outline(node, other) && !outline(node, arm)) {
+    label(lbl2);
+    cold([&]() {
+      label(lbl1);
+      count(node, other);
+      blocks[other]->accept(this, lvl+2);
+      _pf.JMP(mklbl(lbl2));
+    });
+    return;
+  }
+  _pf.JMP(mklbl(lbl2));
+  label(lbl1);
+  count(node, other);
+  blocks[other]->accept(this, lvl+2);
+  label(lbl2);
 }
 
 //------------ BASIC NODES - ITERATION --------------------------------------
@@ -830,8 +1371,7 @@ void xpl::postfix_writer::do_sweep_node(xpl::sweep_node * const node, int lvl) {
     _pf.TRASH(lvalsize);
     // ************************************
 
-    _pf.ALIGN();
-    _pf.LABEL(mklbl(condition));
+    label(condition, node);
 
     // ********** CONDITION NODE *********
     cdk::binary_expression_node* condnode;
@@ -846,10 +1386,10 @@ void xpl::postfix_writer::do_sweep_node(xpl::sweep_node * const node, int lvl) {
     _pf.JZ(mklbl(end));
     // ********* CONDITION NODE OVER *********
 
+    count(node);
     node->block()->accept(this, lvl + 2);
 
-    _pf.ALIGN();
-    _pf.LABEL(mklbl(continu));
+    label(continu);
 
 
     // ******* ADD & STORE **************
@@ -872,8 +1412,7 @@ void xpl::postfix_writer::do_sweep_node(xpl::sweep_node * const node, int lvl) {
     // ******* ADD & STORE OVER *********
 
     _pf.JMP(mklbl(condition));
-    _pf.ALIGN();
-    _pf.LABEL(mklbl(end));
+    label(end);
 
     _nextList.pop_back();
     _stopList.pop_back();
@@ -887,14 +1426,13 @@ void xpl::postfix_writer::do_while_node(xpl::while_node * const node, int lvl) {
   _nextList.push_back(condition);
   _stopList.push_back(end);
 
-  _pf.ALIGN();
-  _pf.LABEL(mklbl(condition));
+  label(condition, node);
   node->condition()->accept(this, lvl+2);
   _pf.JZ(mklbl(end));
+  count(node);
   node->block()->accept(this, lvl+2);
   _pf.JMP(mklbl(condition));
-  _pf.ALIGN();
-  _pf.LABEL(mklbl(end));
+  label(end);
 
   _nextList.pop_back();
   _stopList.pop_back();
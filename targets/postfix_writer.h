@@ -5,10 +5,17 @@
 #include <vector>
 #include <set>
 #include <iostream>
+#include <functional>
+#include <memory>
+#include <sstream>
 #include <cdk/symbol_table.h>
 #include <cdk/emitters/basic_postfix_emitter.h>
 #include "targets/basic_ast_visitor.h"
 #include "targets/symbol.h"
+#include "targets/switch_chain.h"
+#include "targets/pg_hooks.h"
+#include "targets/ir_passes.h"
+#include "targets/profile.h"
 
 namespace xpl {
 
@@ -19,8 +26,10 @@ namespace xpl {
     cdk::symbol_table<xpl::symbol> &_symtab;
     cdk::basic_postfix_emitter &_pf;
     int _lbl;
+    std::string _lblscope;    // Inside functions, labels are named after the function
     int _offset = 0;      // Used for declaring local variables
     int _rtrnlbl = 0;     // Used for the return instruction so it can jump the end of the func
+    int _line = 0;        // With -g, the source line of the code emitted last
 
     std::vector<int> _nextList;     // Next and stop lists are used by whiles and sweeps,
     std::vector<int> _stopList;     // need to keep track of the current label to next/stop
@@ -28,6 +37,14 @@ namespace xpl {
     std::set<std::string> defined;  // Defined and import lists are used to know what to import
     std::set<std::string> imports;  // at the end of the program
     
+    ir::library _inlinable;         // with -O: small functions already compiled (see ir::inlinable)
+    std::set<std::string> _external; // functions with the C calling convention (see external_functions)
+    std::set<xpl::if_else_node*> _chained; // elsifs already read with the head of their chain (see switch_chain)
+
+    std::unique_ptr<xpl::profile> _profile; // execution counts (see -fprofile-generate/-fprofile-use)
+    std::stringstream _cold;        // code that never ran, placed after the function
+    bool _incold = false;           // Used by cold, so that cold code stays where it is written
+
     std::string _adrvar;        // Used just because of strings to know the creator's id (global)
     bool _infn = false;         // Used by alot of nodes, to know if is inside a function or not
     bool _argdcl = false;       // Used by function and decl var, to deal with offset
@@ -74,13 +91,23 @@ namespace xpl {
     /** Method used to generate sequential labels. */
     inline std::string mklbl(int lbl) {
       std::ostringstream oss;
+      std::string prefix = debug() ? "..@L" : "_L";  // with -g, names the linker drops with -X (ld)
       if (lbl < 0)
         oss << ".L" << -lbl;
+      else if (_lblscope != "")  // numbered per function, so its code does not depend on the rest
+        oss << prefix << _lblscope << "." << lbl;
       else
-        oss << "_L" << lbl;
+        oss << prefix << lbl;
       return oss.str();
     }
 
+    // Labels of the compiler's own data (profile counters, ...). They start with
+    // ..@, which no XPL name does, and never with ..@L, the prefix of mklbl's
+    // labels under -g, so they collide with neither.
+    inline static std::string reserved(const std::string &name) {
+      return "..@" + name;
+    }
+
     // Adds an id either to the list of defined identifiers or
     // to the list of identifiers to import
     inline void addId(std::set<std::string> *vec, std::string id) {
@@ -123,6 +150,61 @@ namespace xpl {
     // before another comparision, as this leaves the dcmp value + int(0) on the stack.
     void doublecmp();
 
+    // Calls a function, leaving its result in eax (or st0): internal functions
+    // get their first arguments in registers (see symbol::registers).
+    void call(xpl::funcall_node * const node, int lvl);
+
+    // Key of the function's code in the compiler's cache: its fingerprint plus
+    // the signatures (from the symbol table) of every name it refers to.
+    std::string fragment_key(xpl::function_node * const node);
+
+    // Emits a cached function fragment and replays its imports/definitions:
+    // @return whether the function was kept for inlining when it was made.
+    bool replay(const std::string &fragment);
+
+    // The assembly name of a function: xpl is _main (as the RTS wants), a user's _main is ._main.
+    static std::string name(const std::string &id);
+
+    // A function's SSA form, optimized with -O and ready for lowering (nullptr on errors);
+    // keep stores it for inlining into later functions, if it is small enough.
+    std::unique_ptr<ir::function> ssa(xpl::function_node * const node, std::shared_ptr<xpl::symbol> symbol,
+                                      const std::string &id);
+    bool keep(xpl::function_node * const node, std::unique_ptr<ir::function> &fn);
+
+    // Profiles: counts a point with -fprofile-generate; xpl's dump writes the
+    // counts to the profile file. Labels are aligned except, with a profile, where
+    // they do not head a hot loop (alignment pads with code that may run).
+    void count(const cdk::basic_node *node, int arm = 0);
+    void dump();
+    void label(int lbl, const cdk::basic_node *loop = nullptr);
+
+
+    // Whether an arm never ran (by the profile) and may go after the function,
+    // where cold emits it (cold code is not moved again).
+    bool outline(const cdk::basic_node *node, int arm = 0);
+    void cold(const std::function<void()> &code);
+
+    // Prints the consecutive prints from first on whose values have no effects
+    // (see effectless) and, after the first, cannot trap (see trapless) with one
+    // call of the runtime (see print_format), when they would take more than one:
+    // @return how many it printed (0: none). Only when coalescing.
+    size_t prints(cdk::sequence_node * const node, size_t first, int lvl);
+    bool coalescing() {   // -O or -fcoalesce-prints (also for ir::coalesce_prints)
+      return _compiler->optimize() || _compiler->flag("coalesce-prints");
+    }
+
+    // Generates the program without the functions and variables that neither xpl
+    // nor public code can reach (see call_graph); their size goes to --report.
+    void strip(cdk::sequence_node * const node);
+
+    // Jumps to the label of the arm (sorted by value) that matches the scrutinee,
+    // or to none: through a bounds-checked jump table when the values are dense,
+    // or a binary search of the arms in [lo, hi).
+    void dispatch(cdk::expression_node * const scrutinee, const std::vector<std::pair<int, int>> &arms,
+                  int none, int lvl);
+    void search(cdk::expression_node * const scrutinee, const std::vector<std::pair<int, int>> &arms,
+                size_t lo, size_t hi, int none, int lvl);
+
     // Verifies if the global declaration is being started with an expression
     // Needs to be done inside postfix as typechecker doesn't know if var is global
     void decl_init_check(xpl::decl_variable_node * const node, int lvl);
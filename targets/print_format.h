@@ -0,0 +1,64 @@
+#ifndef __XPL_PRINT_FORMAT_H__
+#define __XPL_PRINT_FORMAT_H__
+
+#include <string>
+
+namespace xpl {
+
+  //!
+  //! The format of one call of the runtime's __xpl_print (see rts/rts.h),
+  //! which prints consecutive prints at once: their constant text (strings
+  //! and ints known at compile time, and newlines) goes in the format, and
+  //! each other value is a directive, printed from the call's arguments.
+  //!
+  class print_format {
+    std::string _format, _text;  // with directives, and as printed when there are no values
+    int _values = 0;
+    int _calls = 0;              // what printing it would take otherwise (printi, println, ...)
+
+  public:
+    /** The name of the runtime function that prints a format. */
+    static const char *printer() {
+      return "__xpl_print";
+    }
+
+    void text(const std::string &text) {
+      for (char c : text) {
+        if (c == '\1') _format += c;  // byte 1 twice is itself
+        _format += c;
+      }
+      _text += text;
+      _calls++;
+    }
+
+    void newline() {
+      _format += '\n';
+      _text += '\n';
+      _calls++;
+    }
+
+    /** A value printed by printer ("printi", "printd" or "prints"). */
+    void value(const std::string &printer) {
+      _format += '\1';
+      _format += printer.back();
+      _values++;
+      _calls++;
+    }
+
+    /** @return the format, or only its text (to print with prints) when there are no values */
+    const std::string &format() const {
+      return _values > 0 ? _format : _text;
+    }
+
+    int values() const {
+      return _values;
+    }
+
+    int calls() const {
+      return _calls;
+    }
+  };
+
+} // xpl
+
+#endif
@@ -0,0 +1,110 @@
+#include <fstream>
+#include <sstream>
+#include "targets/profile.h"
+#include "targets/fingerprint.h"
+#include "ast/all.h"  // automatically generated
+
+//---------------------------------------------------------------------------
+
+xpl::profile::profile(std::shared_ptr<cdk::compiler> compiler, cdk::sequence_node * const program) {
+  walk(program);
+
+  // FNV-1a of the program's canonical text (without lines, which only -g adds):
+  // a profile only fits the program that made it
+  xpl::fingerprint fp(compiler, false);
+  program->accept(&fp, 0);
+  _checksum = 2166136261u;
+  for (unsigned char c : fp.text()) {
+    _checksum ^= c;
+    _checksum *= 16777619u;
+  }
+}
+
+std::string xpl::profile::file(std::shared_ptr<cdk::compiler> compiler, const std::string &flag,
+                               const std::string &extension) {
+  std::string name = compiler->flag(flag, "");
+  if (name != "") return name;
+  const std::string &source = compiler->ifile();
+  if (source == "") return "xpl" + extension;
+  return source.substr(0, source.find_last_of('.')) + extension;
+}
+
+void xpl::profile::add(const cdk::basic_node *node, char kind, int counters) {
+  _points[node] = _kinds.size();
+  _kinds.insert(_kinds.end(), counters, kind);
+}
+
+void xpl::profile::walk(cdk::basic_node * const node) {
+  if (node == nullptr) return;
+  if (auto seq = dynamic_cast<cdk::sequence_node*>(node)) {
+    for (size_t i = 0; i < seq->size(); i++)
+      walk(seq->node(i));
+  } else if (auto fn = dynamic_cast<xpl::function_node*>(node)) {
+    size_t first = _kinds.size();
+    add(fn, 'f', 1);
+    walk(fn->body());
+    _functions[fn] = std::make_pair(first, _kinds.size());
+  } else if (auto body = dynamic_cast<xpl::body_node*>(node)) {
+    walk(body->declarations());
+    walk(body->instructions());
+  } else if (auto block = dynamic_cast<xpl::block_node*>(node)) {
+    walk(block->declarations());
+    walk(block->instructions());
+  } else if (auto branch = dynamic_cast<xpl::if_node*>(node)) {
+    add(branch, 'i', 1);
+    walk(branch->block());
+  } else if (auto branch = dynamic_cast<xpl::if_else_node*>(node)) {
+    add(branch, 'i', 2);
+    walk(branch->thenblock());
+    walk(branch->elseblock());
+  } else if (auto loop = dynamic_cast<xpl::while_node*>(node)) {
+    add(loop, 'l', 1);
+    walk(loop->block());
+  } else if (auto loop = dynamic_cast<xpl::sweep_node*>(node)) {
+    add(loop, 'l', 1);
+    walk(loop->block());
+  }
+}
+
+long xpl::profile::counter(const cdk::basic_node *node, int arm) const {
+  auto point = _points.find(node);
+  return point == _points.end() ? -1 : point->second + arm;
+}
+
+void xpl::profile::load(std::shared_ptr<cdk::compiler> compiler, const std::string &file) {
+  std::ifstream in(file, std::ios::binary);
+  uint32_t header[2] = { 0, 0 };
+  std::vector<uint32_t> counts(size());
+  in.read((char*)header, sizeof header);
+  if (!counts.empty()) in.read((char*)counts.data(), counts.size() * sizeof(uint32_t));
+  if (!in || header[0] != _checksum || header[1] != size()) {
+    compiler->remark("profile: " + file + (in.is_open() ? " is not a profile of this program" : " not found") +
+                     ", not used");
+    return;
+  }
+
+  _counts.swap(counts);
+  for (size_t k = 0; k < _counts.size(); k++)
+    if (_counts[k] > _hottest[_kinds[k]]) _hottest[_kinds[k]] = _counts[k];
+}
+
+long xpl::profile::count(const cdk::basic_node *node, int arm) const {
+  long k = counter(node, arm);
+  return k < 0 || !loaded() ? -1 : _counts[k];
+}
+
+bool xpl::profile::hot(const cdk::basic_node *node, int arm) const {
+  long k = counter(node, arm);
+  if (k < 0 || !loaded() || _counts[k] == 0) return false;
+  return (uint64_t)_counts[k] * 16 >= _hottest.at(_kinds[k]);
+}
+
+std::string xpl::profile::text(const cdk::basic_node *fn) const {
+  auto range = _functions.find(fn);
+  if (range == _functions.end()) return "";
+  std::ostringstream text;
+  text << range->second.first;
+  for (size_t k = range->second.first; loaded() && k < range->second.second; k++)
+    text << " " << _counts[k] << "/" << _hottest.at(_kinds[k]);
+  return text.str();
+}
@@ -0,0 +1,75 @@
+#ifndef __XPL_PROFILE_H__
+#define __XPL_PROFILE_H__
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include <cdk/compiler.h>
+#include <cdk/ast/sequence_node.h>
+
+namespace xpl {
+
+  /**
+   * Execution counts of a program. Its points are the function entries,
+   * the loop bodies (while and sweep) and the arms of the ifs, numbered in
+   * source order. With -fprofile-generate the program counts them and, when
+   * xpl returns, writes the counts to the profile file: a checksum of the
+   * program, the number of counters and the counters (32 bit words). With
+   * -fprofile-use the file is read back (a profile of another program is
+   * ignored, with a remark) and drives code generation: arms that never ran
+   * go out of the way, only hot loops are aligned, and hot functions are
+   * inlined more eagerly.
+   */
+  class profile {
+    std::map<const cdk::basic_node*, size_t> _points;  // first counter of each point
+    std::map<const cdk::basic_node*, std::pair<size_t, size_t>> _functions; // counters of each function
+    std::vector<char> _kinds;                          // of each counter: 'f'unction, 'l'oop or 'i'f
+    uint32_t _checksum;
+    std::vector<uint32_t> _counts;                     // read with -fprofile-use
+    std::map<char, uint32_t> _hottest;                 // the highest count of each kind
+
+  public:
+    profile(std::shared_ptr<cdk::compiler> compiler, cdk::sequence_node * const program);
+
+    /** @return the profile file: the value of the flag, or the source's name ending in extension */
+    static std::string file(std::shared_ptr<cdk::compiler> compiler, const std::string &flag,
+                            const std::string &extension = ".prof");
+
+    size_t size() const {
+      return _kinds.size();
+    }
+    uint32_t checksum() const {
+      return _checksum;
+    }
+
+    /** @return the counter of a point (arm 1 is the else of an if-else), -1 if node is not one */
+    long counter(const cdk::basic_node *node, int arm = 0) const;
+
+    /** Reads the counts; reports (as a remark) a missing or mismatched file. */
+    void load(std::shared_ptr<cdk::compiler> compiler, const std::string &file);
+
+    bool loaded() const {
+      return !_counts.empty();
+    }
+    /** @return how often the point ran (-1 without a profile) */
+    long count(const cdk::basic_node *node, int arm = 0) const;
+    /** @return whether the point ran at least 1/16 as often as the busiest one of its kind */
+    bool hot(const cdk::basic_node *node, int arm = 0) const;
+    /** @return whether the profile says the point never ran */
+    bool cold(const cdk::basic_node *node, int arm = 0) const {
+      return count(node, arm) == 0;
+    }
+
+    /** @return the counters of a function and their counts (what its code depends on, for cache keys) */
+    std::string text(const cdk::basic_node *fn) const;
+
+  private:
+    void walk(cdk::basic_node * const node);
+    void add(const cdk::basic_node *node, char kind, int counters);
+  };
+
+} // xpl
+
+#endif
@@ -13,23 +13,23 @@ void xpl::sizeof_calculator::do_sequence_node(cdk::sequence_node * const node, i
 }
 
 void xpl::sizeof_calculator::do_integer_node(cdk::integer_node * const node, int lvl) {
-  _size += 4;
+  grow(4);
 }
 
 void xpl::sizeof_calculator::do_double_node(cdk::double_node * const node, int lvl) {
-  _size += 8;
+  grow(8);
 }
 
 void xpl::sizeof_calculator::do_string_node(cdk::string_node * const node, int lvl) {
-  _size += 4;
+  grow(4);
 }
 
 void xpl::sizeof_calculator::do_decl_variable_node(xpl::decl_variable_node * const node, int lvl) {
-	_size += (node->type()->name() == basic_type::TYPE_DOUBLE) ? 8 : 4;
+	grow((node->type()->name() == basic_type::TYPE_DOUBLE) ? 8 : 4);
 }
 
 void xpl::sizeof_calculator::do_function_node(xpl::function_node * const node, int lvl) {
-  _size += node->type()->size();
+  grow(node->type()->size());
 	node->body()->accept(this, lvl);
 }
 
@@ -39,8 +39,10 @@ void xpl::sizeof_calculator::do_body_node(xpl::body_node * const node, int lvl)
 }
 
 void xpl::sizeof_calculator::do_block_node(xpl::block_node * const node, int lvl) {
+  int outer = _size;
 	node->declarations()->accept(this, lvl);
   node->instructions()->accept(this, lvl);
+  _size = outer;  // the postfix_writer reuses the block's slots after it
 }
 
 void xpl::sizeof_calculator::do_if_node(xpl::if_node * const node, int lvl) {
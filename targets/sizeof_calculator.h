@@ -12,7 +12,8 @@ namespace xpl {
    * Print nodes as XML elements to the output stream.
    */
   class sizeof_calculator: public basic_ast_visitor {
-    int _size = 0;
+    int _size = 0;   // bytes live at this point (blocks give theirs back when they end)
+    int _max = 0;    // the most ever live: sibling blocks share their bytes
 
   public:
     sizeof_calculator(std::shared_ptr<cdk::compiler> compiler) :
@@ -20,10 +21,16 @@ namespace xpl {
     }
 
     int size() {
-      return _size;
+      return _max;
     }
 
 
+  private:
+    void grow(int bytes) {
+      _size += bytes;
+      if (_size > _max) _max = _size;
+    }
+
   public:
     void do_sequence_node(cdk::sequence_node * const node, int lvl);
 
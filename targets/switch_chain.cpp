@@ -0,0 +1,61 @@
+#include <set>
+#include <string>
+#include "targets/switch_chain.h"
+#include "targets/type_checker.h"
+#include "ast/all.h"  // automatically generated
+
+//---------------------------------------------------------------------------
+
+// A variable of type int, or an int literal (maybe negated), as in "x == -3".
+static cdk::rvalue_node *variable(cdk::expression_node * const node) {
+  auto rvalue = dynamic_cast<cdk::rvalue_node*>(node);
+  if (rvalue == nullptr || rvalue->type()->name() != basic_type::TYPE_INT) return nullptr;
+  return dynamic_cast<cdk::identifier_node*>(rvalue->lvalue()) == nullptr ? nullptr : rvalue;
+}
+static bool literal(cdk::expression_node * const node, int &value) {
+  auto neg = dynamic_cast<cdk::neg_node*>(node);
+  if (neg != nullptr && literal(neg->argument(), value)) {
+    value = -value;
+    return true;
+  }
+  auto integer = dynamic_cast<cdk::integer_node*>(node);
+  if (integer == nullptr) return false;
+  value = integer->value();
+  return true;
+}
+
+xpl::switch_chain::switch_chain(std::shared_ptr<cdk::compiler> compiler, cdk::symbol_table<xpl::symbol> &symtab,
+                                basic_ast_visitor *parent, xpl::if_else_node * const node) {
+  std::set<int> seen;
+  std::string name;
+  std::unique_ptr<xpl::type_checker> checker;
+  otherwise = node;
+  while (otherwise != nullptr) {
+    auto chain = dynamic_cast<xpl::if_else_node*>(otherwise);
+    auto last = dynamic_cast<xpl::if_node*>(otherwise);
+    auto eq = dynamic_cast<cdk::eq_node*>(chain ? chain->condition() : last ? last->condition() : nullptr);
+    if (eq == nullptr) break;
+    if (eq->type() == nullptr || eq->type()->name() == basic_type::TYPE_UNSPEC) {
+      try {
+        if (checker == nullptr) checker.reset(new xpl::type_checker(compiler, symtab, parent));
+        eq->accept(checker.get(), 0);
+      } catch (const std::string &problem) {
+        break;
+      }
+    }
+    cdk::rvalue_node *var = variable(eq->left());
+    int value;
+    if (var == nullptr || !literal(eq->right(), value)) {
+      var = variable(eq->right());
+      if (var == nullptr || !literal(eq->left(), value)) break;
+    }
+    std::string id = dynamic_cast<cdk::identifier_node*>(var->lvalue())->name();
+    if (scrutinee != nullptr && id != name) break;
+    scrutinee = var;
+    name = id;
+    if (seen.insert(value).second)
+      arms.push_back(std::make_pair(value, chain ? chain->thenblock() : last->block()));
+    if (chain != nullptr && chain != node) chained.push_back(chain);
+    otherwise = chain ? chain->elseblock() : nullptr;
+  }
+}
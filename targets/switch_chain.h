@@ -0,0 +1,35 @@
+#ifndef __XPL_SWITCH_CHAIN_H__
+#define __XPL_SWITCH_CHAIN_H__
+
+#include <memory>
+#include <utility>
+#include <vector>
+#include <cdk/compiler.h>
+#include <cdk/symbol_table.h>
+#include "targets/basic_ast_visitor.h"
+#include "targets/symbol.h"
+
+namespace xpl {
+
+  /**
+   * The arms of an if/elsif chain that compare the same int variable with
+   * int literals (value, statement; later repeats of a value are left out),
+   * up to the first one that does not. Otherwise is what runs when none
+   * matches. Read by postfix_writer and ir_builder, which dispatch chains
+   * of ir::SWITCH_CASES or more arms.
+   */
+  struct switch_chain {
+    cdk::expression_node *scrutinee = nullptr;
+    std::vector<std::pair<int, cdk::basic_node*>> arms;
+    cdk::basic_node *otherwise = nullptr;
+    std::vector<xpl::if_else_node*> chained;  // the elsifs read after the head (theirs would be fewer)
+
+    // Conditions after the first are only typed when their statement is visited:
+    // they are checked here (errors end the chain; they are reported then).
+    switch_chain(std::shared_ptr<cdk::compiler> compiler, cdk::symbol_table<xpl::symbol> &symtab,
+                 basic_ast_visitor *parent, xpl::if_else_node * const node);
+  };
+
+} // xpl
+
+#endif
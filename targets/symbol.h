@@ -12,6 +12,7 @@ namespace xpl {
       bool _local;        // Se e var global ou local (usado em postfix identifier node)
       bool _fn;           // Se e funcao
       bool _fndef;        // Se e funcao, se ja ta definida
+      bool _internal = false; // Se e funcao nem public nem use (ver registers)
       basic_type *_type;  // Tipo do identifier
       std::string _name;  // Nome do identifier
       long _value;        // Valor do offset
@@ -54,6 +55,22 @@ namespace xpl {
       inline void fndef(bool b) {
         _fndef = b;
       }
+      inline bool internal() {
+        return _internal;
+      }
+      inline void internal(bool b) {
+        _internal = b;
+      }
+      /**
+       * Internal functions (only called from this file) take their leading int,
+       * string and pointer arguments, up to three, in registers (see POPR/PUSHR).
+       * @return how many arguments are passed in registers
+       */
+      inline size_t registers() {
+        size_t n = 0;
+        while (_internal && n < _arglist.size() && n < 3 && _arglist[n].size() == 4) n++;
+        return n;
+      }
 
       inline basic_type *type() const {
         return _type;
@@ -153,7 +153,7 @@ namespace xpl {
     (node)->accept(&checker, 0); \
   } \
   catch (const std::string &problem) { \
-    std::cerr << (node)->lineno() << ": " << problem << std::endl; \
+    (compiler)->error((node)->lineno(), problem); \
     return; \
   } \
 }
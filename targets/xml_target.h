@@ -23,7 +23,7 @@ namespace xpl {
 
       xml_writer writer(compiler, symtab);
       compiler->ast()->accept(&writer, 0);
-      return true;
+      return compiler->errors() == 0;
     }
 
   };
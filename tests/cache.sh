@@ -0,0 +1,26 @@
+#!/bin/sh
+# cache.sh compiler program.xpl...: compiles each program without the cache and
+# with a warm one (after compiling it once, a comment is added, so that only
+# the functions' fragments can be reused), with and without -O, and checks
+# that the outputs are identical.
+xpl=$1; shift
+work=$(mktemp -d) || exit 1
+trap 'rm -rf "$work"' EXIT
+status=0
+for program in "$@"; do
+  case $(basename "$program") in error*) continue;; esac
+  for flags in "" -O; do
+    rm -rf "$work/cache"
+    cp "$program" "$work/p.xpl"
+    "$xpl" $flags --cache "$work/cache" -o "$work/first.asm" "$work/p.xpl" || { status=1; continue; }
+    echo "// changed" >> "$work/p.xpl"
+    "$xpl" $flags -o "$work/cold.asm" "$work/p.xpl"
+    "$xpl" $flags --cache "$work/cache" -o "$work/warm.asm" "$work/p.xpl"
+    if ! cmp -s "$work/cold.asm" "$work/warm.asm"; then
+      echo "$program ($flags): the warm cache changes the output"
+      status=1
+    fi
+  done
+done
+[ $status = 0 ] && echo "cache: warm and cold outputs are identical"
+exit $status
@@ -0,0 +1,26 @@
+#!/bin/sh
+# expected.sh compiler program.xpl...: compiles each program that has its
+# expected output next to it (program.out) without the IR, through it (-fir)
+# and with -O (so that each pass is checked by the programs written for it),
+# links it with the runtime (make rts) and checks what it prints.
+xpl=$1; shift
+rts=$(cd "$(dirname "$0")/../rts" && pwd)
+work=$(mktemp -d) || exit 1
+trap 'rm -rf "$work"' EXIT
+status=0
+for program in "$@"; do
+  expected=${program%.xpl}.out
+  [ -f "$expected" ] || continue
+  for flags in "" -fir -O; do
+    rm -f "$work/p.asm" "$work/p.o" "$work/p"
+    "$xpl" $flags -o "$work/p.asm" "$program" &&
+      yasm -felf32 -o "$work/p.o" "$work/p.asm" &&
+      ld -m elf_i386 -o "$work/p" "$work/p.o" -L"$rts" -lrts || { status=1; continue; }
+    if ! "$work/p" | cmp -s - "$expected"; then
+      echo "$program ($flags): the output differs from $expected"
+      status=1
+    fi
+  done
+done
+[ $status = 0 ] && echo "expected: all outputs are as expected"
+exit $status
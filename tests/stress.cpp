@@ -0,0 +1,106 @@
+// Compiles programs in many threads at once (cdk::compile) and compares every
+// result, byte for byte, with a serial compilation of the same program and
+// options. Programs whose names start with "error" must fail, with messages
+// (and no exit); the others must compile.
+//
+//   stress [-j threads] [-n rounds] program.xpl...
+
+#include <atomic>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cdk/compile.h>
+
+namespace {
+
+  struct options {
+    const char *target;
+    bool optimize;
+  };
+
+  const options configurations[] = { { "asm", false }, { "asm", true }, { "xml", false } };
+
+  struct job {
+    std::string name, source;
+    const options *config;
+    std::string expected;  // the serial compilation's
+  };
+
+  // Everything a compilation produces, as text.
+  std::string compile(const job &j) {
+    cdk::compilation_result result = cdk::compile("xpl", j.source, j.config->target, j.config->optimize);
+    std::ostringstream text;
+    text << (result.ok ? "ok\n" : "failed\n");
+    for (auto &d : result.diagnostics)
+      text << d.line << ": " << d.message << "\n";
+    text << result.output;
+    return text.str();
+  }
+
+  std::string base(const std::string &path) {
+    return path.substr(path.find_last_of('/') + 1);
+  }
+
+}
+
+int main(int argc, char *argv[]) {
+  int threads = 8, rounds = 5;
+  std::vector<job> jobs;
+  for (int ax = 1; ax < argc; ax++) {
+    std::string option = argv[ax];
+    if (option == "-j" && ax + 1 < argc)
+      threads = std::atoi(argv[++ax]);
+    else if (option == "-n" && ax + 1 < argc)
+      rounds = std::atoi(argv[++ax]);
+    else {
+      std::ifstream file(option);
+      if (!file) {
+        std::cerr << option << ": cannot read" << std::endl;
+        return 1;
+      }
+      std::ostringstream source;
+      source << file.rdbuf();
+      for (auto &o : configurations)
+        jobs.push_back(job { option, source.str(), &o, "" });
+    }
+  }
+
+  int failures = 0;
+  for (auto &j : jobs) {
+    j.expected = compile(j);
+    bool failed = j.expected.compare(0, 3, "ok\n") != 0;
+    if (failed != (base(j.name).compare(0, 5, "error") == 0)) {
+      std::cerr << j.name << " (" << j.config->target << (j.config->optimize ? " -O" : "")
+                << "): " << (failed ? "failed" : "compiled") << "\n" << j.expected << std::endl;
+      failures++;
+    }
+  }
+
+  std::atomic<int> mismatches(0);
+  std::mutex report;
+  std::vector<std::thread> workers;
+  for (int t = 0; t < threads; t++)
+    workers.emplace_back([&, t] {
+      for (int r = 0; r < rounds; r++)
+        for (size_t k = 0; k < jobs.size(); k++) {
+          const job &j = jobs[(k + t) % jobs.size()];  // threads compile different programs at once
+          if (compile(j) == j.expected) continue;
+          if (mismatches++ == 0) {
+            std::lock_guard<std::mutex> lock(report);
+            std::cerr << j.name << " (" << j.config->target << (j.config->optimize ? " -O" : "")
+                      << "): differs from the serial compilation" << std::endl;
+          }
+        }
+    });
+  for (auto &w : workers)
+    w.join();
+
+  std::cout << jobs.size() << " compilations, " << threads << " threads x " << rounds << " rounds: "
+            << failures << " unexpected results, " << mismatches << " mismatches" << std::endl;
+  return failures == 0 && mismatches == 0 ? 0 : 1;
+}
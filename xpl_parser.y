@@ -4,14 +4,14 @@
 #include <cdk/compiler.h>
 #include "ast/all.h"
 #define LINE       compiler->scanner()->lineno()
-#define yylex()    compiler->scanner()->scan()
+#define yylex(lval) (xpl_parser_lval = (lval), compiler->scanner()->scan())
 #define yyerror(s) compiler->scanner()->error(s)
 #define YYPARSE_PARAM_TYPE std::shared_ptr<cdk::compiler>
 #define YYPARSE_PARAM      compiler
 //-- don't change *any* of these --- END!
 #define DEFVOID  new basic_type(0, basic_type::TYPE_VOID)
 
-int USE = 1, PUBLIC = 2;
+const int USE = 1, PUBLIC = 2;
 
 bool toImport(int qualifier) {
   return qualifier == USE ? true : false;
@@ -38,6 +38,8 @@ cdk::expression_node* omissionValue(int line, basic_type *type) {
 
 %}
 
+%pure-parser
+
 %union {
   int                  i;	        /* integer value */
   double               d;         /* real value */
@@ -50,6 +52,12 @@ cdk::expression_node* omissionValue(int line, basic_type *type) {
   cdk::lvalue_node     *lvalue;   
 };
 
+%{
+// The parser is re-entrant: its semantic value lives in yyparse's own frame.
+// The scanner reaches it through this pointer, set before each token is read.
+thread_local YYSTYPE *xpl_parser_lval = nullptr;
+%}
+
 %token <i> tINTEGER
 %token <d> tREAL
 %token <s> tIDENTIFIER tSTRING
@@ -222,7 +230,7 @@ literal : tINTEGER  { $$ = new cdk::integer_node(LINE, $1); }
         | word      { $$ = new cdk::string_node(LINE, $1); }
         ; 
 
-word : word tSTRING  { $$ = new std::string(*$1 + *$2); delete $1; delete $2; }
+word : word tSTRING  { $$ = cdk::arena::make<std::string>(*$1 + *$2); cdk::arena::dispose($1); cdk::arena::dispose($2); }
      | tSTRING       { $$ = $1; }
      ; 
 